@@ -3,134 +3,181 @@
 // global instance
 Runtime runtime = {0};
 
+_Thread_local jmp_buf* apc_handler = NULL;
+_Thread_local ErrorCode apc_error = E_OK;
+
 void apc_init() {
 
     signal(SIGINT, ctrl_c_signal_handler);
 
-    // init shared memory
-    runtime.error_code = mmap(NULL, sizeof(ErrorCode),
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED | MAP_ANON,
-        -1, 0);
-    if (runtime.error_code == MAP_FAILED) {
-        fputs(" = memory error\n", stdout);
-        exit(E_MEMORY_ERROR);
-    }
+    // crashes are handled on a stack of their own, a stack overflow has
+    // none left to run the handler on
+    stack_t crash_stack = {
+        .ss_sp = apc_malloc_persistent(SIGSTKSZ),
+        .ss_size = SIGSTKSZ
+    };
+    sigaltstack(&crash_stack, NULL);
+
+    struct sigaction crash = {
+        .sa_handler = crash_signal_handler,
+        .sa_flags = SA_ONSTACK
+    };
+    sigemptyset(&crash.sa_mask);
+    sigaction(SIGSEGV, &crash, NULL);
+    sigaction(SIGBUS, &crash, NULL);
+    sigaction(SIGFPE, &crash, NULL);
 
     // init opdata lookup tables
     runtime.n_unops = 2;
-    runtime.unop_data = apc_malloc(runtime.n_unops * sizeof(UnopData));
+    runtime.unop_data = apc_malloc_persistent(runtime.n_unops * sizeof(UnopData));
     runtime.unop_data[0] = (UnopData){'+', UnopFn_Plus};
     runtime.unop_data[1] = (UnopData){'-', UnopFn_Minus};
 
-    runtime.n_binops = 6;
-    runtime.binop_data = apc_malloc(runtime.n_binops * sizeof(BinopData));
+    runtime.n_binops = 7;
+    runtime.binop_data = apc_malloc_persistent(runtime.n_binops * sizeof(BinopData));
     runtime.binop_data[0] = (BinopData){'+', BinopFn_Add};
     runtime.binop_data[1] = (BinopData){'-', BinopFn_Sub};
     runtime.binop_data[2] = (BinopData){'*', BinopFn_Mul};
     runtime.binop_data[3] = (BinopData){'/', BinopFn_Div};
     runtime.binop_data[4] = (BinopData){'%', BinopFn_Mod};
-    // explicit base _ is not an operator, handled in consume_numlit
+    // explicit base _ is not an operator, handled in parse_numlit
     runtime.binop_data[5] = (BinopData){'#', BinopFn_BaseConv};
+    // ** is scanned as ^
+    runtime.binop_data[6] = (BinopData){'^', BinopFn_Pow};
+
+    runtime.n_funcs = 13;
+    runtime.func_data = apc_malloc_persistent(runtime.n_funcs * sizeof(FuncData));
+    runtime.func_data[0] = (FuncData){"powmod", FuncFn_PowMod, 3};
+    // special form, see compile_into
+    runtime.func_data[1] = (FuncData){"mod", FuncFn_Mod, 2};
+    runtime.func_data[2] = (FuncData){"gcd", FuncFn_Gcd, 2};
+    runtime.func_data[3] = (FuncData){"lcm", FuncFn_Lcm, 2};
+    runtime.func_data[4] = (FuncData){"invmod", FuncFn_InvMod, 2};
+    runtime.func_data[5] = (FuncData){"isqrt", FuncFn_ISqrt, 1};
+    runtime.func_data[6] = (FuncData){"iroot", FuncFn_IRoot, 2};
+    runtime.func_data[7] = (FuncData){"fact", FuncFn_Fact, 1};
+    runtime.func_data[8] = (FuncData){"binom", FuncFn_Binom, 2};
+    runtime.func_data[9] = (FuncData){"fib", FuncFn_Fib, 1};
+    runtime.func_data[10] = (FuncData){"lucas", FuncFn_Lucas, 1};
+    runtime.func_data[11] = (FuncData){"pi", FuncFn_Pi, 1};
+    runtime.func_data[12] = (FuncData){"e", FuncFn_E, 1};
 
     // init bignum library stuff
     BN_CONFIG.no_free = BC_NF_ENABLED;
     BN_CONFIG.malloc_hook = apc_malloc;
     BN_CONFIG.realloc_hook = apc_realloc;
     BN_CONFIG.free_hook = apc_free;
+
+    // APC_THREADS=n caps the thread pool, default is one thread per core
+    const char* n_threads = getenv("APC_THREADS");
+    pool_set_n_threads((n_threads != NULL) ? strtoul(n_threads, NULL, 10) : 0);
+    BN_CONFIG.n_threads = pool_n_threads();
+    BN_CONFIG.spawn_hook = pool_spawn_hook;
+    BN_CONFIG.join_hook = pool_join_hook;
+
+    // APC_MEMO_BYTES=n bounds the results kept for repeated operations
+    const char* memo_bytes = getenv("APC_MEMO_BYTES");
+    if (memo_bytes != NULL) {
+        memo_set_budget(strtoull(memo_bytes, NULL, 10));
+    }
 }
 
 void apc_exit(int exit_code) {
-    munmap(runtime.error_code, sizeof(ErrorCode));
     exit(exit_code);
 }
 
-void apc_eval(const char* str) {
-
-    int pid = fork();
-    if (pid == 0) {
-        // child
+// parse, evaluate and print one line, errors go to apc_return()
+static void apc_eval_line(const char* str) {
 
-        // set error code to something bad in case child exits w/o apc_return
-        *runtime.error_code = E_INTERNAL_ERROR;
+    runtime.current_input = sv_from(str);
 
-        runtime.current_input = sv_from(str);
+    if (!parens_are_balanced(runtime.current_input)) {
+        apc_return(E_PARSE_ERROR);
+    }
 
-        if (!parens_are_balanced(runtime.current_input)) {
-            apc_return(E_PARSE_ERROR);
-        }
+    // "" => parse error
+    // this will never trigger in the repl, only from argv
+    if (runtime.current_input.len == 0) {
+        apc_return(E_PARSE_ERROR);
+    }
 
-        // "" => parse error
-        // this will never trigger in the repl, only from argv
-        if (runtime.current_input.len == 0) {
-            apc_return(E_PARSE_ERROR);
+    // init
+    runtime.last_index = 0;
+    runtime.current_token = (Token){T_NONE};
+
+    // parse
+    parser_next_token();
+    Token target;
+    bool assign = parse_assign_target(&target);
+    Expr* e = optimize_expr(parse_expr());
+
+    // compile + eval, after bringing every variable it reads up to date
+    SymbolTable* st = &runtime.symbols;
+    Program p = compile_expr(e);
+    for (size_t i = 0; i < p.n_code; i++) {
+        if (p.code[i].op == OP_LOAD) {
+            symtab_refresh(st, p.code[i].a);
         }
+    }
 
-        // init
-        runtime.tokens = NULL;
-        runtime.n_tokens = 0;
-        runtime.last_index = 0;
-        runtime.current_token = (Token){T_NONE};
+    // x = x * 3 writes its result over the digits x already has
+    int64_t var = assign ? symtab_find(st, target.atom) : -1;
+    if (var >= 0) {
+        compile_write_back(&p, var);
+    }
 
-        // read all tokens into a list
-        while(scan_next_token()) {
-            runtime.n_tokens += 1;
-            runtime.tokens = apc_realloc(runtime.tokens,
-                runtime.n_tokens * sizeof(Token));
-            runtime.tokens[runtime.n_tokens-1] = runtime.current_token;
-        }
+    Value final_result = vm_run(&p);
 
-        // parse
-        runtime.token_index = 0;
-        runtime.current_token = (Token){T_NONE};
-        parser_next_token();
+    // the variable only changes once the whole line went through
+    if (assign) {
+        size_t i = symtab_intern(st, target.atom);
+        symtab_define(st, i, &p, &final_result);
+        final_result = st->vars[i].value;
+    }
 
-        Expr* e = consume_expr();
+    // print
+    fputs(" = ", stdout);
 
-        // eval
-        Value final_result = eval_expr(e);
+    // always print explicit base if not base10
+    // always print in uppercase for now to match python
+    bn_print2(&final_result.number,
+        final_result.number.base != BN_BASE_DEFAULT,
+        BN_PRINT_UPPERCASE);
+}
 
-        // print
-        fputs(" = ", stdout);
+void apc_eval(const char* str) {
 
-        // always print explicit base if not base10
-        // always print in uppercase for now to match python
-        bn_print2(&final_result.number,
-            final_result.number.base != BN_BASE_DEFAULT,
-            BN_PRINT_UPPERCASE);
+    jmp_buf handler;
+    apc_handler = &handler;
 
-        // done
-        *runtime.error_code = E_OK;
-        apc_return(E_OK);
+    if (setjmp(handler) == 0) {
+        apc_eval_line(str);
+        runtime.error_code = E_OK;
+    } else {
+        runtime.error_code = apc_error;
 
-    } else if (pid > 0) {
-        // parent
-        wait(NULL);
+        // the pool may still be working on this line
+        pool_drain(apc_error);
 
-        if (*runtime.error_code == E_OK) {
-            // do nothing, child already printed result
-        } else if (*runtime.error_code == E_NAME_ERROR) {
+        if (apc_error == E_NAME_ERROR) {
             fputs(" = name error", stdout);
-        } else if (*runtime.error_code == E_VALUE_ERROR) {
+        } else if (apc_error == E_VALUE_ERROR) {
             fputs(" = value error", stdout);
-        } else if (*runtime.error_code == E_PARSE_ERROR) {
+        } else if (apc_error == E_PARSE_ERROR) {
             fputs(" = syntax error", stdout);
-        } else if (*runtime.error_code == E_MEMORY_ERROR) {
+        } else if (apc_error == E_MEMORY_ERROR) {
             fputs(" = memory error", stdout);
-        } else if (*runtime.error_code == E_PROCESS_ERROR) {
+        } else if (apc_error == E_PROCESS_ERROR) {
             fputs(" = process error", stdout);
-        } else if (*runtime.error_code == E_INTERNAL_ERROR) {
-            fputs(" = internal error", stdout);
         } else {
             fputs(" = internal error", stdout);
         }
-        fputc('\n', stdout);
-    } else {
-        // fork failed
-        *runtime.error_code = E_PROCESS_ERROR;
-        fputs(" = process error\n", stdout);
-        apc_exit(E_PROCESS_ERROR);
     }
+    fputc('\n', stdout);
+    fflush(stdout);
+
+    apc_handler = NULL;
+    apc_free_all();
 }
 
 void apc_start_repl() {
@@ -167,8 +214,8 @@ void apc_start_repl() {
         apc_eval(line);
 
         // exit on "bad" error types
-        if (*runtime.error_code >= E_BAD_ERROR_LEVEL) {
-            apc_exit(*runtime.error_code);
+        if (runtime.error_code >= E_BAD_ERROR_LEVEL) {
+            apc_exit(runtime.error_code);
         }
     }
 
@@ -176,8 +223,11 @@ void apc_start_repl() {
 }
 
 void apc_return(ErrorCode exit_code) {
-    *runtime.error_code = exit_code;
-    exit(exit_code);
+    if (apc_handler == NULL) {
+        exit(exit_code);
+    }
+    apc_error = exit_code;
+    longjmp(*apc_handler, 1);
 }
 
 // internal
@@ -211,6 +261,15 @@ BinopData* rt_get_binop(char name) {
     return NULL;
 }
 
+FuncData* rt_get_func(const char* name) {
+    for (size_t i = 0; i < runtime.n_funcs; i++) {
+        if (!strcmp(name, runtime.func_data[i].name)) {
+            return &runtime.func_data[i];
+        }
+    }
+    return NULL;
+}
+
 void expr_print(const Expr* e) {
     if (e->type == X_VALUE) {
         fputs("Value{", stdout);
@@ -226,93 +285,153 @@ void expr_print(const Expr* e) {
         fputs(", ", stdout);
         expr_print(e->binop.arg1);
         fputc('}', stdout);
+    } else if (e->type == X_FUNC) {
+        printf("Func{%s", e->func.data->name);
+        for (size_t i = 0; i < e->func.n_args; i++) {
+            fputs(", ", stdout);
+            expr_print(e->func.args[i]);
+        }
+        fputc('}', stdout);
+    } else if (e->type == X_PRODUCT) {
+        fputs("Product{", stdout);
+        for (size_t i = 0; i < e->product.n_factors; i++) {
+            if (i > 0) {
+                fputs(", ", stdout);
+            }
+            expr_print(e->product.factors[i]);
+        }
+        fputc('}', stdout);
+    } else if (e->type == X_SUM) {
+        fputs("Sum{", stdout);
+        for (size_t i = 0; i < e->sum.n_terms; i++) {
+            if (i > 0) {
+                fputs(", ", stdout);
+            }
+            fputs(e->sum.negate[i] ? "-" : "+", stdout);
+            expr_print(e->sum.terms[i]);
+        }
+        fputc('}', stdout);
+    } else if (e->type == X_SHIFT) {
+        printf("Shift{%s, ", e->shift.right ? ">>" : "<<");
+        expr_print(e->shift.arg);
+        printf(", %llu}", (unsigned long long)e->shift.k);
+    } else if (e->type == X_VAR) {
+        printf("Var{%s}", runtime.symbols.vars[e->var.index].name);
     } else {
         printf("Expr{???}");
     }
 }
 
+size_t expr_n_children(const Expr* e) {
+    switch (e->type) {
+        case X_VALUE: return 0;
+        case X_UNOP: return 1;
+        case X_BINOP: return 2;
+        case X_FUNC: return e->func.n_args;
+        case X_PRODUCT: return e->product.n_factors;
+        case X_SUM: return e->sum.n_terms;
+        case X_SHIFT: return 1;
+        case X_VAR: return 0;
+    }
+    return 0;
+}
+
+Expr** expr_child(Expr* e, size_t i) {
+    switch (e->type) {
+        case X_VALUE: break;
+        case X_UNOP: return &e->unop.arg;
+        case X_BINOP: return (i == 0) ? &e->binop.arg0 : &e->binop.arg1;
+        case X_FUNC: return &e->func.args[i];
+        case X_PRODUCT: return &e->product.factors[i];
+        case X_SUM: return &e->sum.terms[i];
+        case X_SHIFT: return &e->shift.arg;
+        case X_VAR: break;
+    }
+    apc_return(E_INTERNAL_ERROR);
+    return NULL;
+}
+
+// single character tokens, T_NONE for anything else
+static const TokenType scan_char_token[256] = {
+    [','] = T_COMMA,
+    ['('] = T_OPEN,
+    [')'] = T_CLOSE,
+    ['_'] = T_BASE,
+    ['+'] = T_PLUS,
+    ['-'] = T_MINUS,
+    ['*'] = T_STAR,
+    ['/'] = T_SLASH,
+    ['%'] = T_PERCENT,
+    ['#'] = T_CONV,
+    ['^'] = T_POW,
+    ['='] = T_ASSIGN,
+};
+
 bool scan_next_token() {
     const char* s = runtime.current_input.str;
     size_t l = runtime.current_input.len;
-
-    if (s == NULL
-    || l == 0
-    || runtime.last_index >= l) {
-        return false;
-    }
+    size_t i = runtime.last_index;
 
     // skip leading spaces
-    while (runtime.last_index < l
-    && isspace(s[runtime.last_index])) {
-        runtime.last_index += 1;
+    while (i < l && isspace((unsigned char)s[i])) {
+        i += 1;
     }
 
-    // "   \t  "
-    if (runtime.last_index == l) {
+    if (s == NULL || i >= l) {
+        runtime.last_index = i;
         return false;
     }
 
     Token t = {
-        .type = T_NONE,
-        .atom = { .str = (char*)s + runtime.last_index, .len = 1 }
+        .type = scan_char_token[(unsigned char)s[i]],
+        .atom = { .str = (char*)s + i, .len = 1 }
     };
 
-    // consume a single character (an operator)
-
-    char c = t.atom.str[0];
-    if (c == ',') t.type = T_COMMA;
-    else if (c == '(') t.type = T_OPEN;
-    else if (c == ')') t.type = T_CLOSE;
-    else if (c == '_') t.type = T_BASE;
-    else if (c == '+') t.type = T_PLUS;
-    else if (c == '-') t.type = T_MINUS;
-    else if (c == '*') t.type = T_STAR;
-    else if (c == '/') t.type = T_SLASH;
-    else if (c == '%') t.type = T_PERCENT;
-    else if (c == '#') t.type = T_CONV;
-
-    if (t.type != T_NONE) {
-        // advance ptr and write token
-        runtime.last_index += t.atom.len;
-        runtime.current_token = t;
-        return true;
+    // ** is scanned as ^
+    if (t.type == T_STAR && i + 1 < l && s[i + 1] == '*') {
+        t.type = T_POW;
+        t.atom.len = 2;
     }
 
-    // consume a whole word, stopping at first space or operator
-
-    t.type = T_NUMBER;
-    while (runtime.last_index < l) {
-        c = s[runtime.last_index];
-
-        if (char_in_string(c, ",()_+-*/%#") || isspace(c)) {
-            break;
-        } else if (!isalnum(c)) {
+    if (t.type == T_NONE) {
+        // consume a whole word, stopping at first space or operator
+        t.type = T_NUMBER;
+        bool has_alpha = false;
+        size_t j = i;
+        while (j < l && isalnum((unsigned char)s[j])) {
+            has_alpha = has_alpha || isalpha((unsigned char)s[j]);
+            j += 1;
+        }
+        if (j == i
+        || (j < l && !isspace((unsigned char)s[j])
+            && scan_char_token[(unsigned char)s[j]] == T_NONE)) {
             apc_return(E_PARSE_ERROR);
         }
-
-        t.atom.len += 1;
-        runtime.last_index += 1;
+        t.atom.len = j - i;
+
+        // if there was a-zA-Z in the word and it doesn't have explicit base,
+        // it's an identifier
+        if (has_alpha) {
+            size_t next = j;
+            while (next < l && isspace((unsigned char)s[next])) {
+                next += 1;
+            }
+            if (next == l || s[next] != '_') {
+                t.type = T_IDENT;
+            }
+        }
     }
 
-    // backtrack by 1, to handle this character (either a single char operator
-    // or whitespace) next iteration
-    t.atom.len -= 1;
-
-    // if there was a-zA-Z in the word and it doesn't have explicit base,
-    // it's an identifier
-
-    // advance ptr and write token
+    runtime.last_index = i + t.atom.len;
     runtime.current_token = t;
     return true;
 }
 
 bool parser_next_token() {
-    if (runtime.token_index >= runtime.n_tokens) {
+    if (!scan_next_token()) {
+        runtime.current_token = (Token){T_NONE};
         return false;
     }
-
-    runtime.current_token = runtime.tokens[runtime.token_index];
-    runtime.token_index += 1;
     return true;
 }
 
@@ -330,119 +449,319 @@ void parser_expect(TokenType ttype) {
     }
 }
 
-bool parser_lookahead(Token* out) {
-    if (runtime.token_index + 1 >= runtime.n_tokens) {
+bool parse_assign_target(Token* name_out) {
+    if (runtime.current_token.type != T_IDENT) {
+        return false;
+    }
+
+    // one token of lookahead, put everything back if it's not an "="
+    Token name = runtime.current_token;
+    size_t last_index = runtime.last_index;
+    parser_next_token();
+
+    if (!parser_accept(T_ASSIGN)) {
+        runtime.current_token = name;
+        runtime.last_index = last_index;
         return false;
     }
 
-    *out = runtime.tokens[runtime.token_index + 1];
+    *name_out = name;
     return true;
 }
 
-Expr* consume_numlit() {
+// numlit => \d+ | \d+ "_" \d+
+static Expr* parse_numlit() {
+    Token t_num = runtime.current_token;
+    parser_expect(T_NUMBER);
 
-    Token t_num;
-    Token t_base;
-    Token t_base_10 = { .type=T_NUMBER, .atom=sv_from("10") };
-
-    // bignum value
-    t_num = runtime.current_token;
-    if (parser_accept(T_NUMBER)) {
+    // bignum with explicit base
+    if (parser_accept(T_BASE)) {
+        Token t_base = runtime.current_token;
+        parser_expect(T_NUMBER);
+        return build_expr_num(t_num, &t_base);
+    }
 
-        // bignum with explicit base
-        if (parser_accept(T_BASE)) {
-            t_base = runtime.current_token;
-            parser_expect(T_NUMBER);
-            return build_expr_num(t_num, &t_base);
-        }
+    // bignum without base - default to 10
+    return build_expr_num(t_num, NULL);
+}
 
-        // bignum without base - default to 10
-        return build_expr_num(t_num, &t_base_10);
+typedef enum {
+    PF_UNOP,
+    PF_BINOP,
+    PF_PAREN,   // "(" expr
+    PF_CALL     // ident "(" expr, ...
+} ParseFrameType;
+
+typedef struct {
+    ParseFrameType type;
+    Token token;    // the operator, or the name of a call
+    uint8_t bp;     // binding power of an operator
+    size_t n_args;  // finished arguments of a call
+} ParseFrame;
+
+// binding power of an infix operator, 0 if t isn't one
+static uint8_t parse_infix_bp(TokenType t) {
+    switch (t) {
+        case T_PLUS:
+        case T_MINUS:
+        case T_PERCENT:
+        case T_CONV:
+            return 10;
+        case T_STAR:
+        case T_SLASH:
+            return 20;
+        case T_POW:
+            return 40;
+        default:
+            return 0;
     }
-
-    apc_return(E_PARSE_ERROR);
-    // unreachable
-    return NULL;
 }
 
-Expr* consume_factor() {
+#define PARSE_PREFIX_BP 30
+
+typedef struct {
+    Expr** operands;
+    size_t n_operands;
+    size_t operands_capacity;
 
-    Expr* e;
-    Token t;
+    ParseFrame* frames;
+    size_t n_frames;
+    size_t frames_capacity;
 
-    // unop
-    t = runtime.current_token;
-    if (parser_accept(T_PLUS) || parser_accept(T_MINUS)) {
-        e = consume_factor();
-        return build_expr_unop(t, e);
+    // the first name or value error, raised once the whole line parsed so
+    // a syntax error anywhere in it comes first
+    ErrorCode error;
+} Parser;
+
+static void parser_push_operand(Parser* p, Expr* e) {
+    if (p->n_operands == p->operands_capacity) {
+        p->operands_capacity = p->operands_capacity
+            ? 2 * p->operands_capacity : 16;
+        p->operands = apc_realloc(p->operands,
+            p->operands_capacity * sizeof(Expr*));
     }
+    p->operands[p->n_operands] = e;
+    p->n_operands += 1;
+}
 
-    // numlit
-    if (t.type == T_NUMBER) {
-        return consume_numlit();
+static void parser_push_frame(Parser* p, ParseFrame f) {
+    if (p->n_frames == p->frames_capacity) {
+        p->frames_capacity = p->frames_capacity
+            ? 2 * p->frames_capacity : 16;
+        p->frames = apc_realloc(p->frames,
+            p->frames_capacity * sizeof(ParseFrame));
     }
+    p->frames[p->n_frames] = f;
+    p->n_frames += 1;
+}
 
-    // ( expr )
-    if (parser_accept(T_OPEN)) {
-        e = consume_expr();
-        parser_expect(T_CLOSE);
-        return e;
+// an operand that can't be built, a 0 stands in for it until the error is
+// raised at the end
+static void parser_defer(Parser* p, ErrorCode error) {
+    if (p->error == E_OK) {
+        p->error = error;
     }
 
-    apc_return(E_PARSE_ERROR);
-    // unreachable
-    return NULL;
+    Expr* e = expr_new();
+    e->type = X_VALUE;
+    e->value.type = V_NUMBER;
+    bni_write_parts1(&e->value.number, 0, 0, BN_BASE_DEFAULT);
+    parser_push_operand(p, e);
 }
 
-Expr* consume_term() {
-    Expr* term;
-    Expr* factor_n;
-    Token op;
+// pop the top operator and apply it to the operands on top of the stack
+static void parser_apply(Parser* p) {
+    ParseFrame f = p->frames[p->n_frames - 1];
+    p->n_frames -= 1;
 
-    term = consume_factor();
+    if (f.type == PF_UNOP) {
+        Expr** arg = &p->operands[p->n_operands - 1];
+        *arg = build_expr_unop(f.token, *arg);
+        return;
+    }
 
-    while (runtime.current_token.type == T_STAR
-    || runtime.current_token.type == T_SLASH) {
-        op = runtime.current_token;
-        if (!parser_next_token()) {
-            apc_return(E_PARSE_ERROR);
+    Expr* arg1 = p->operands[p->n_operands - 1];
+    Expr** arg0 = &p->operands[p->n_operands - 2];
+    p->n_operands -= 1;
+
+    // a * b * c => Product{a, b, c}, a + b - c => Sum{a, b, -c}
+    // a chain is broken by any other operator
+    if (f.token.type == T_STAR) {
+        if ((*arg0)->type == X_PRODUCT) {
+            expr_product_append(*arg0, arg1);
+        } else {
+            *arg0 = build_expr_product(*arg0, arg1);
         }
+    } else if (f.token.type == T_PLUS || f.token.type == T_MINUS) {
+        if ((*arg0)->type != X_SUM) {
+            *arg0 = build_expr_sum(*arg0);
+        }
+        expr_sum_append(*arg0, arg1, f.token.type == T_MINUS);
+    } else {
+        *arg0 = build_expr_binop(f.token, *arg0, arg1);
+    }
+}
 
-        // term *= factor_n
-        factor_n = consume_factor();
-        // left associative
-        // 5 + 6 - 7 => -(+(5,6), 7)
-        term = build_expr_binop(op, term, factor_n);
+// apply every operator on top of the stack that binds tighter than bp
+// equal binding power also applies, unless it's right associative
+static void parser_reduce(Parser* p, uint8_t bp, bool right_assoc) {
+    while (p->n_frames > 0) {
+        ParseFrame* top = &p->frames[p->n_frames - 1];
+        if (top->type != PF_UNOP && top->type != PF_BINOP) {
+            break;
+        }
+        if (top->bp < bp || (top->bp == bp && right_assoc)) {
+            break;
+        }
+        parser_apply(p);
     }
-    return term;
 }
 
-Expr* consume_expr() {
-    Expr* expr;
-    Expr* term_n;
-    Token op;
+// ident "(" args... ")" - the call frame is on top, its args are the top
+// operands
+static void parser_finish_call(Parser* p) {
+    ParseFrame f = p->frames[p->n_frames - 1];
+    p->n_frames -= 1;
+
+    size_t n_args = f.n_args;
+    Expr** args = NULL;
+    if (n_args > 0) {
+        args = apc_malloc(n_args * sizeof(Expr*));
+        memcpy(args, &p->operands[p->n_operands - n_args],
+            n_args * sizeof(Expr*));
+        p->n_operands -= n_args;
+    }
 
-    expr = consume_term();
+    Expr* e = build_expr_func(f.token, args, n_args);
 
-    while(runtime.current_token.type == T_PLUS
-    || runtime.current_token.type == T_MINUS
-    || runtime.current_token.type == T_PERCENT
-    || runtime.current_token.type == T_CONV) {
-        op = runtime.current_token;
-        if (!parser_next_token()) {
-            apc_return(E_PARSE_ERROR);
+    if (e->func.data == NULL) {
+        parser_defer(p, E_NAME_ERROR);
+        return;
+    }
+
+    int64_t expected = e->func.data->expected_n_args;
+    if (expected != -1 && (size_t)expected != n_args) {
+        parser_defer(p, E_VALUE_ERROR);
+        return;
+    }
+
+    parser_push_operand(p, e);
+}
+
+Expr* parse_expr() {
+    Parser p = {0};
+
+    // true when the next token starts an operand, false when it follows one
+    bool want_operand = true;
+
+    while (true) {
+        Token t = runtime.current_token;
+
+        if (want_operand) {
+            if (t.type == T_NUMBER) {
+                parser_push_operand(&p, parse_numlit());
+                want_operand = false;
+
+            } else if (t.type == T_IDENT) {
+                parser_next_token();
+
+                // a bare name is a variable
+                if (!parser_accept(T_OPEN)) {
+                    Expr* e = build_expr_var(t);
+                    if (e != NULL) {
+                        parser_push_operand(&p, e);
+                    } else {
+                        parser_defer(&p, E_NAME_ERROR);
+                    }
+                    want_operand = false;
+                    continue;
+                }
+
+                parser_push_frame(&p, (ParseFrame){ .type = PF_CALL, .token = t });
+                if (parser_accept(T_CLOSE)) {
+                    parser_finish_call(&p);
+                    want_operand = false;
+                }
+
+            } else if (t.type == T_OPEN) {
+                parser_next_token();
+                parser_push_frame(&p, (ParseFrame){ .type = PF_PAREN, .token = t });
+
+            } else if (t.type == T_PLUS || t.type == T_MINUS) {
+                parser_next_token();
+                parser_push_frame(&p, (ParseFrame){
+                    .type = PF_UNOP, .token = t, .bp = PARSE_PREFIX_BP
+                });
+
+            } else {
+                apc_return(E_PARSE_ERROR);
+            }
+            continue;
         }
 
-        // conv requires an explicit base literal afterward
-        if (op.type == T_CONV) {
-            term_n = consume_numlit();
+        uint8_t bp = parse_infix_bp(t.type);
+
+        if (t.type == T_CONV) {
+            // conv requires an explicit base literal afterward, so it's
+            // applied right away
+            parser_next_token();
+            parser_reduce(&p, bp, false);
+            Expr** arg0 = &p.operands[p.n_operands - 1];
+            *arg0 = build_expr_binop(t, *arg0, parse_numlit());
+
+        } else if (bp > 0) {
+            parser_next_token();
+            bool right_assoc = (t.type == T_POW);
+            parser_reduce(&p, bp, right_assoc);
+            parser_push_frame(&p, (ParseFrame){
+                .type = PF_BINOP, .token = t, .bp = bp
+            });
+            want_operand = true;
+
+        } else if (t.type == T_COMMA) {
+            parser_next_token();
+            parser_reduce(&p, 0, false);
+            if (p.n_frames == 0 || p.frames[p.n_frames - 1].type != PF_CALL) {
+                apc_return(E_PARSE_ERROR);
+            }
+            p.frames[p.n_frames - 1].n_args += 1;
+            want_operand = true;
+
+        } else if (t.type == T_CLOSE) {
+            parser_next_token();
+            parser_reduce(&p, 0, false);
+            if (p.n_frames == 0) {
+                apc_return(E_PARSE_ERROR);
+            }
+            ParseFrame* top = &p.frames[p.n_frames - 1];
+            if (top->type == PF_PAREN) {
+                p.n_frames -= 1;
+            } else {
+                top->n_args += 1;
+                parser_finish_call(&p);
+            }
+
+        } else if (t.type == T_NONE) {
+            parser_reduce(&p, 0, false);
+            if (p.n_frames > 0) {
+                apc_return(E_PARSE_ERROR);
+            }
+            break;
+
         } else {
-            term_n = consume_term();
+            // two operands in a row
+            apc_return(E_PARSE_ERROR);
         }
+    }
 
-        expr = build_expr_binop(op, expr, term_n);
+    if (p.error != E_OK) {
+        apc_return(p.error);
     }
-    return expr;
+
+    Expr* e = p.operands[0];
+    apc_free(p.operands);
+    apc_free(p.frames);
+    return e;
 }
 
 Expr* build_expr_num(Token num, const Token* opt_base) {
@@ -471,6 +790,18 @@ Expr* build_expr_num(Token num, const Token* opt_base) {
     return e;
 }
 
+Expr* build_expr_var(Token name) {
+    int64_t i = symtab_find(&runtime.symbols, name.atom);
+    if (i < 0 || !runtime.symbols.vars[i].defined) {
+        return NULL;
+    }
+
+    Expr* e = expr_new();
+    e->type = X_VAR;
+    e->var.index = i;
+    return e;
+}
+
 Expr* build_expr_unop(Token op, Expr* arg) {
     Expr* e = expr_new();
     e->type = X_UNOP;
@@ -482,28 +813,69 @@ Expr* build_expr_unop(Token op, Expr* arg) {
 Expr* build_expr_binop(Token op, Expr* arg0, Expr* arg1) {
     Expr* e = expr_new();
     e->type = X_BINOP;
-    e->binop.data = rt_get_binop(op.atom.str[0]);
+    e->binop.data = rt_get_binop(op.type == T_POW ? '^' : op.atom.str[0]);
     e->binop.arg0 = arg0;
     e->binop.arg1 = arg1;
     return e;
 }
 
-Value eval_expr(const Expr* e) {
-    if (e->type == X_VALUE) {
-        return e->value;
-    } else if (e->type == X_UNOP) {
-        Value v0 = eval_expr(e->unop.arg);
-        Value v = e->unop.data->fn(v0);
-        return v;
-    } else if (e->type == X_BINOP) {
-        Value v0 = eval_expr(e->binop.arg0);
-        Value v1 = eval_expr(e->binop.arg1);
-        Value v = e->binop.data->fn(v0, v1);
-        return v;
-    }
+Expr* build_expr_func(Token name, Expr** args, size_t n_args) {
+    stringbuffer name_str = sb_slice(name.atom.str, 0, name.atom.len);
 
-    apc_return(E_INTERNAL_ERROR);
-    // unreachable
-    return (Value){0};
+    Expr* e = expr_new();
+    e->type = X_FUNC;
+    e->func.data = rt_get_func(name_str.str);
+    e->func.args = args;
+    e->func.n_args = n_args;
+
+    sb_free(&name_str);
+    return e;
 }
 
+Expr* build_expr_sum(Expr* arg0) {
+    Expr* e = expr_new();
+    e->type = X_SUM;
+    e->sum.terms = apc_malloc(sizeof(Expr*));
+    e->sum.negate = apc_malloc(sizeof(bool));
+    e->sum.terms[0] = arg0;
+    e->sum.negate[0] = false;
+    e->sum.n_terms = 1;
+    return e;
+}
+
+Expr* build_expr_product(Expr* arg0, Expr* arg1) {
+    Expr* e = expr_new();
+    e->type = X_PRODUCT;
+    e->product.factors = apc_malloc(2 * sizeof(Expr*));
+    e->product.factors[0] = arg0;
+    e->product.factors[1] = arg1;
+    e->product.n_factors = 2;
+    return e;
+}
+
+// the arrays are resized when the count reaches a power of 2
+static bool needs_grow(size_t n) {
+    return n >= 2 && (n & (n - 1)) == 0;
+}
+
+void expr_product_append(Expr* e, Expr* factor) {
+    Product* p = &e->product;
+    if (needs_grow(p->n_factors)) {
+        p->factors = apc_realloc(p->factors,
+            2 * p->n_factors * sizeof(Expr*));
+    }
+    p->factors[p->n_factors] = factor;
+    p->n_factors += 1;
+}
+
+void expr_sum_append(Expr* e, Expr* term, bool negate) {
+    Sum* s = &e->sum;
+    if (s->n_terms == 1 || needs_grow(s->n_terms)) {
+        size_t capacity = (s->n_terms == 1) ? 2 : 2 * s->n_terms;
+        s->terms = apc_realloc(s->terms, capacity * sizeof(Expr*));
+        s->negate = apc_realloc(s->negate, capacity * sizeof(bool));
+    }
+    s->terms[s->n_terms] = term;
+    s->negate[s->n_terms] = negate;
+    s->n_terms += 1;
+}
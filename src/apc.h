@@ -1,9 +1,9 @@
 #ifndef APC_H
 #define APC_H
 
+#include <setjmp.h>
 #include <signal.h>
-#include <sys/mman.h>
-#include <sys/wait.h>
+#include <stdatomic.h>
 #include <unistd.h>
 
 #include "memory.h"
@@ -38,14 +38,20 @@ void apc_eval(const char* str);
 // start repl mode ("q" to exit)
 void apc_start_repl();
 
-// apc uses two separate processes:
-// main process - start child, wait, print result, repeat in repl mode
-// child process - parse and evaluate expr, write error code, exit
+// everything runs in one process, so variables last the whole session
+// an error unwinds to the innermost handler on the calling thread - the one
+// in apc_eval(), or the one around a pool task - and everything the
+// evaluation allocated with apc_malloc() is freed once it's done
 
-// write error code to shared memory, exit from child proc with exit_code
+// the innermost handler on this thread, apc_return() sets apc_error and
+// jumps to it, with no handler it exits
+extern _Thread_local jmp_buf* apc_handler;
+extern _Thread_local ErrorCode apc_error;
+
+// abandon the current evaluation with exit_code
 void apc_return(ErrorCode exit_code);
 
-// unmap shared memory, exit from main proc with exit_code
+// exit with exit_code
 void apc_exit(int exit_code);
 
 // internal
@@ -113,8 +119,12 @@ typedef enum {
     V_NUMBER
 } ValueType;
 
+// values are passed around by copy and share their digits freely - owned
+// marks a temporary whose digits nothing else uses, that dies in the call it's
+// passed to, so the callee may write its result over them
 typedef struct Value {
     ValueType type;
+    bool owned;
     union {
         Bignum number;
     };
@@ -168,6 +178,8 @@ typedef enum {
     T_SLASH,    // / division
     T_PERCENT,  // % modulo
     T_CONV,     // # base conversion operator
+    T_POW,      // ^ or ** exponentiation
+    T_ASSIGN,   // = assignment
 } TokenType;
 
 typedef struct {
@@ -182,7 +194,12 @@ typedef struct Expr Expr;
 typedef enum {
     X_VALUE,
     X_UNOP,
-    X_BINOP
+    X_BINOP,
+    X_FUNC,
+    X_PRODUCT,
+    X_SUM,
+    X_SHIFT,
+    X_VAR
 } ExprType;
 
 typedef struct {
@@ -196,26 +213,170 @@ typedef struct {
     Expr* arg1;
 } Binop;
 
+typedef struct {
+    FuncData* data;
+    Expr** args;
+    size_t n_args;
+} Func;
+
+// a0 * a1 * ... - a chain of 2 or more factors, multiplied as a tree
+typedef struct {
+    Expr** factors;
+    size_t n_factors;
+} Product;
+
+// a0 + a1 - a2 ... - a chain of 2 or more terms, added in one pass
+typedef struct {
+    Expr** terms;
+    bool* negate;   // true if the term is subtracted
+    size_t n_terms;
+} Sum;
+
+// arg * scale or arg / scale, where scale = fake_base^k in its own base
+// only built by optimize_expr()
+typedef struct {
+    Expr* arg;
+    Value scale;
+    uint64_t k;
+    bool right;     // true for division
+} Shift;
+
+// a variable, read when the expression is run
+typedef struct {
+    size_t index;   // into runtime.symbols.vars
+} Var;
+
 struct Expr {
     ExprType type;
+    uint64_t cost;  // estimated work in limb operations, set by optimize_expr()
+    bool reads_var; // some node in it is an X_VAR, set along with cost
     union {
         Value value;
         Unop unop;
         Binop binop;
+        Func func;
+        Product product;
+        Sum sum;
+        Shift shift;
+        Var var;
     };
 };
 
 #define expr_new() \
-    (calloc(1, sizeof(Expr)))
+    (memset(apc_malloc(sizeof(Expr)), 0, sizeof(Expr)))
 
 void expr_print(const Expr* e);
 
+// children of any node, in evaluation order - used by the passes that walk
+// the tree with an explicit stack
+size_t expr_n_children(const Expr* e);
+Expr** expr_child(Expr* e, size_t i);
+
+// modular context - inside mod(m, expr), every +, -, * result in expr is
+// reduced mod m and ^ becomes powmod, with the reducers built once for m
+typedef struct {
+    BignumBarrett barrett;
+    BignumMont mont;
+    bool has_mont;              // false if m shares a factor with real_base
+} ModContext;
+
+// bytecode - an Expr is compiled into a flat list of register instructions
+// the result of every subexpression goes in a register picked at compile
+// time, temporaries are reused as soon as their parent instruction runs
+
+typedef enum {
+    OP_CONST,       // r[dst] = consts[a]
+    OP_POS,         // r[dst] = +r[a]
+    OP_NEG,         // r[dst] = -r[a]
+    OP_ADD,         // r[dst] = r[a] + r[b]
+    OP_SUB,         // r[dst] = r[a] - r[b]
+    OP_MUL,         // r[dst] = r[a] * r[b]
+    OP_DIV,         // r[dst] = r[a] / r[b]
+    OP_MOD,         // r[dst] = r[a] % r[b]
+    OP_POW,         // r[dst] = r[a] ^ r[b]
+    OP_CONV,        // r[dst] = r[a] # r[b]
+    OP_LSHIFT,      // r[dst] = r[a] * consts[b], consts[b] = fake_base^c
+    OP_RSHIFT,      // r[dst] = r[a] / consts[b], consts[b] = fake_base^c
+    OP_POWMOD,      // r[dst] = r[a] ^ r[b] in ModContext ctx
+    OP_PRODUCT,     // r[dst] = r[a] * ... * r[a + b - 1]
+    OP_SUM,         // r[dst] = r[a] + ... + r[a + b - 1]
+    OP_CALL,        // r[dst] = funcs[c](r[a], ..., r[a + b - 1])
+    OP_MOD_INIT,    // build ModContext ctx from r[a]
+    OP_MOD_END,     // r[dst] = r[a] reduced in ModContext ctx, then free it
+    OP_LOAD,        // r[dst] = runtime.symbols.vars[a], owned if b
+    OP_SPAWN,       // job a runs code up to code[b] on the pool, into r[dst]
+    OP_JOIN,        // r[dst] = the result of job a, once it's done
+    OP_RET          // return r[a]
+} OpCode;
+
+typedef struct {
+    OpCode op;
+    int32_t ctx;    // ModContext the result is reduced in, or -1
+    uint32_t dst;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} Instr;
+
+typedef struct {
+    Instr* code;
+    size_t n_code;
+
+    // literal values, loaded with OP_CONST
+    Value* consts;
+    size_t n_consts;
+
+    size_t n_regs;
+    size_t n_ctx;   // one ModContext slot per mod() in the expression
+    size_t n_jobs;  // one job slot per OP_SPAWN
+} Program;
+
+// variables
+
+// definitions form a graph - when a variable changes, everything defined in
+// terms of it is marked dirty, and recomputed the next time it's read, but
+// only if one of its inputs really ended up different
+typedef struct {
+    char* name;
+    bool defined;   // false until the first assignment finishes
+    Value value;    // the digits belong to the table, not to an evaluation
+
+    // the compiled definition, or n_code == 0 for a plain value - x = x + 1
+    // and anything that would make a cycle are plain values
+    Program def;
+    size_t* deps;           // variables def reads
+    uint64_t* dep_versions; // their versions when value was computed
+    size_t n_deps;
+
+    // variables whose definitions read this one
+    size_t* users;
+    size_t n_users;
+    size_t users_capacity;
+
+    uint64_t version;       // bumped whenever value changes
+    bool dirty;             // an input may have changed since
+} Variable;
+
+typedef struct {
+    // in order of first use, indices never change
+    Variable* vars;
+    size_t n_vars;
+    size_t vars_capacity;
+
+    // open addressing over vars, 0 is empty and i + 1 means vars[i]
+    size_t* slots;
+    size_t n_slots;     // a power of 2
+} SymbolTable;
+
 // runtime
 
 typedef struct {
 
-    // shared memory
-    ErrorCode* error_code;
+    // result of the last apc_eval()
+    ErrorCode error_code;
+
+    // every variable so far
+    SymbolTable symbols;
 
     // runtime data
 
@@ -227,6 +388,10 @@ typedef struct {
     BinopData* binop_data;
     size_t n_binops;
 
+    // list of functions
+    FuncData* func_data;
+    size_t n_funcs;
+
     // parser state
 
     // user input string currently being parsed
@@ -236,15 +401,9 @@ typedef struct {
     size_t last_index;
 
     // scan_next_token() and parser_next_token() write to this
+    // tokens are scanned one at a time as the parser asks for them
     Token current_token;
 
-    // list of tokens from the input string
-    Token* tokens;
-    size_t n_tokens;
-
-    // used for parser_next_token()
-    size_t token_index;
-
 } Runtime;
 extern Runtime runtime;
 
@@ -255,61 +414,189 @@ extern Runtime runtime;
 // returns false if no more tokens
 bool scan_next_token();
 
-// read from the list of tokens and "consume" one
-// increments runtime.token_index
-// puts next token in runtime.current_token
-// returns false if no more tokens
+// scan the next token, puts it in runtime.current_token
+// at the end of the input, runtime.current_token is T_NONE and this
+// returns false
 bool parser_next_token();
 
+// statement => ident "=" expr | expr
+// consumes ident "=" and returns true if the statement is an assignment,
+// otherwise consumes nothing
+bool parse_assign_target(Token* name_out);
+
 // optionally consumes a token
 // returns true and gets next token if it matches the current one
-// if optional_out is not NULL, runtime.current_token is also copied there
 bool parser_accept(TokenType ttype);
 
 // required, consumes a token
 // apc_return(E_PARSE_ERROR) if not matched
-// if optional_out is not NULL, runtime.current_token is also copied there
 void parser_expect(TokenType ttype);
 
-// does not consume a token
-// loads the token after the current one into out
-// returns false if not matched or the current one is the end
-bool parser_lookahead(Token* out);
-
 /*
 
+operator precedence, loosest first - all left associative except ^
+
+    + - % #     binary, # takes a numlit on its right
+    * /         binary
+    + -         unary prefix
+    ^           binary, right associative
+
 numlit => \d+
     | \d+ "_" \d+
 
-factor => numlit
-    | "+" factor
-    | "-" factor
-    | "(" expr ")"
+call => ident "(" ")"
+    | ident "(" expr ("," expr)* ")"
 
-term => factor
-    | factor "*" factor
+primary => numlit
+    | call
+    | "(" expr ")"
 
-expr => term
-    | term "+" term
-    | term "-" term
+a * b * c and a + b - c chains are collected into Product and Sum nodes
+2 ^ 3 ^ 2 => ^(2, ^(3, 2)), -2 ^ 2 => -(^(2, 2))
 
 */
 
-Expr* consume_numlit();
-Expr* consume_factor();
-Expr* consume_term();
-Expr* consume_expr();
+// pratt parser, reads the whole input
+// operators and open parens/calls live on an explicit stack, so nesting
+// depth doesn't use any C stack
+Expr* parse_expr();
 
 // these constructors never fail or consume any tokens
 
 // if opt_base is NULL it defaults to base 10
 Expr* build_expr_num(Token num, const Token* opt_base);
+// NULL if the variable isn't defined
+Expr* build_expr_var(Token name);
 Expr* build_expr_unop(Token op, Expr* arg);
 Expr* build_expr_binop(Token op, Expr* arg0, Expr* arg1);
+Expr* build_expr_func(Token name, Expr** args, size_t n_args);
+Expr* build_expr_product(Expr* arg0, Expr* arg1);
+// starts a Sum with one term, add the rest with expr_sum_append()
+Expr* build_expr_sum(Expr* arg0);
+
+// append to a Product or Sum, the arrays grow by doubling
+void expr_product_append(Expr* e, Expr* factor);
+void expr_sum_append(Expr* e, Expr* term, bool negate);
+
+// optimize.c
+
+// constant folding and simplification, returns the new root
+// bottom up - every node whose operands are all values is evaluated, then
+// x * 1, x + 0, +x and (x # a) # b are simplified, and * or / by a power of
+// the radix becomes a Shift
+// nothing inside the expression of a mod() is touched, since the
+// reductions there make a / b or a % b depend on the exact tree
+// sibling subtrees that are both expensive are folded on separate threads
+Expr* optimize_expr(Expr* e);
+
+// a subtree estimated to cost this many limb operations gets a task of its
+// own, when one of its siblings does too
+#define SPAWN_COST_THRESHOLD (1ull << 22)
+
+// vm.c
+
+// lower an expression to bytecode, the Program doesn't reference e afterward
+// sibling subtrees that read variables and are both expensive (by the costs
+// optimize_expr() left) run on separate threads
+Program compile_expr(const Expr* e);
+
+// let the last instruction of p write its result straight over the digits of
+// vars[var] when that's the only thing reading them, for a line assigned back
+// to vars[var] - p then can't be run again
+void compile_write_back(Program* p, size_t var);
+
+// run a compiled Program, it can be run any number of times
+Value vm_run(const Program* p);
+
+void program_free(Program* p);
+
+// a copy of p, constants included, that outlives the evaluation
+Program program_copy_persistent(const Program* p);
+void program_free_persistent(Program* p);
+
+// same for a single value, the copy has its own digits
+Value value_copy_persistent(const Value* v);
+void value_free_persistent(Value* v);
+
+// pool.c - work stealing thread pool, one thread per core
+// an error in a task is caught there and raised again by pool_join()
+
+typedef void (*TaskFn)(void* arg);
+
+typedef struct {
+    TaskFn fn;
+    void* arg;
+    atomic_bool done;
+    ErrorCode error;
+} Task;
+
+// queue fn(arg) to run on any thread, t must stay alive until pool_join(t)
+void pool_spawn(Task* t, TaskFn fn, void* arg);
 
-// evaluating
+// wait for t, running other queued tasks in the meantime and sleeping when
+// there are none
+// join tasks in the reverse order they were spawned
+void pool_join(Task* t);
 
-Value eval_expr(const Expr* e);
+// after an error - skip whatever is still queued and wait for the running
+// tasks to give up, so nothing touches the evaluation's memory afterward
+void pool_drain(ErrorCode error);
+
+// set before anything is spawned, 0 means one thread per core
+void pool_set_n_threads(size_t n);
+size_t pool_n_threads();
+
+// pool_spawn() and pool_join() with the Task allocated in between, for
+// BN_CONFIG.spawn_hook and join_hook
+void* pool_spawn_hook(TaskFn fn, void* arg);
+void pool_join_hook(void* handle);
+
+// symtab.c
+
+// index of name, or -1
+int64_t symtab_find(const SymbolTable* st, stringview name);
+
+// index of name, added as undefined if it isn't there yet
+size_t symtab_intern(SymbolTable* st, stringview name);
+
+// vars[i] = v, the old digits are overwritten in place when there's room
+// returns false if the value was already v
+bool symtab_assign(SymbolTable* st, size_t i, const Value* v);
+
+// vars[i] = v, the result of running def, which is kept as the definition of
+// vars[i] when possible - whatever reads vars[i] is marked dirty if it changed
+void symtab_define(SymbolTable* st, size_t i, const Program* def,
+                   const Value* v);
+
+// bring vars[i] up to date, recomputing the dirty definitions it depends on
+void symtab_refresh(SymbolTable* st, size_t i);
+
+// memo.c - results of expensive operations, kept across lines
+// bounded by a memory budget, the least recently used results go first
+
+// smaller operations (operands and result together, in digits) are cheaper
+// to do again than to look up
+#define MEMO_MIN_LEN 256
+
+// budget when APC_MEMO_BYTES isn't set
+#define MEMO_DEFAULT_BUDGET (64ull << 20)
+
+// one operation on some values
+typedef struct {
+    uint64_t tag;       // what is done to the arguments
+    const Value* args;
+    size_t n_args;
+} MemoKey;
+
+// the most memory the cached results may take, 0 turns the cache off
+// results over the new budget are dropped right away
+void memo_set_budget(size_t bytes);
+
+// the result remembered for key, in memory of the evaluation in progress
+bool memo_find(const MemoKey* key, Value* out);
+
+// remember result for key, everything is copied
+void memo_insert(const MemoKey* key, const Value* result);
 
 // builtins.c
 
@@ -323,15 +610,34 @@ Value BinopFn_Sub(Value a0, Value a1); // a0 + a1
 Value BinopFn_Mul(Value a0, Value a1); // a0 * a1
 Value BinopFn_Div(Value a0, Value a1); // a0 / a1
 Value BinopFn_Mod(Value a0, Value a1); // a0 % a1
+Value BinopFn_Pow(Value a0, Value a1); // a0 ^ a1
 Value BinopFn_BaseConv(Value a0, Value b); // a0 # b
 
-// utils.c
+// functions
+Value FuncFn_PowMod(FuncArgs args); // powmod(a0, a1, m)
+Value FuncFn_Mod(FuncArgs args); // mod(m, a0)
+Value FuncFn_Gcd(FuncArgs args); // gcd(a0, a1)
+Value FuncFn_Lcm(FuncArgs args); // lcm(a0, a1)
+Value FuncFn_InvMod(FuncArgs args); // invmod(a0, m)
+Value FuncFn_ISqrt(FuncArgs args); // isqrt(a0)
+Value FuncFn_IRoot(FuncArgs args); // iroot(a0, n)
+Value FuncFn_Fact(FuncArgs args); // fact(a0)
+Value FuncFn_Binom(FuncArgs args); // binom(a0, a1)
+Value FuncFn_Fib(FuncArgs args); // fib(a0)
+Value FuncFn_Lucas(FuncArgs args); // lucas(a0)
+Value FuncFn_Pi(FuncArgs args); // pi(a0)
+Value FuncFn_E(FuncArgs args); // e(a0)
 
-bool char_in_string(char c, const char* str);
+// utils.c
 
 // only handles () rn, []{} are ignored
 bool parens_are_balanced(stringview sv);
 
 void ctrl_c_signal_handler(int s);
 
+// there's no child process to die in place of the whole session any more,
+// so a crash prints the same thing it used to and exits, the session and
+// its variables go with it
+void crash_signal_handler(int s);
+
 #endif // APC_H
@@ -66,7 +66,10 @@ BignumConfig BN_CONFIG = {
     .no_free = BC_NF_DISABLED,
     .malloc_hook = malloc,
     .realloc_hook = realloc,
-    .free_hook = free
+    .free_hook = free,
+    .n_threads = 1,
+    .spawn_hook = NULL,
+    .join_hook = NULL
 };
 
 // constructors and io
@@ -233,7 +236,7 @@ void bn_sub(Bignum* result, const Bignum* a0, const Bignum* a1) {
 
     // a0 - a0 => 0
     if (cmp == 0) {
-        bni_write_parts1(result, 0, 0, BN_BASE_DEFAULT);
+        bni_write_parts1(result, 0, 0, arg0.base);
         return;
     }
 
@@ -264,8 +267,52 @@ void bn_sub(Bignum* result, const Bignum* a0, const Bignum* a1) {
     bni_sub(result, &arg0, &arg1);
 }
 
+void bn_sum(Bignum* result, const Bignum* args, size_t n) {
+
+    if (n == 0) {
+        bni_write_parts1(result, 0, 0, BN_BASE_DEFAULT);
+        return;
+    }
+
+    bn_base_t base = bni_bcm_base(args, n);
+
+    bool same_base = true;
+    for (size_t i = 0; i < n; i++) {
+        same_base = same_base && args[i].base == base;
+    }
+    if (same_base) {
+        bni_sum(result, args, n);
+        return;
+    }
+
+    Bignum* conv = BN_MALLOC(n * sizeof(Bignum));
+    for (size_t i = 0; i < n; i++) {
+        conv[i] = (Bignum){0};
+        if (args[i].base == base) {
+            bni_copy(&conv[i], &args[i]);
+        } else {
+            bni_convert(&conv[i], &args[i], base);
+        }
+    }
+
+    bni_sum(result, conv, n);
+
+    for (size_t i = 0; i < n; i++) {
+        bni_try_free(&conv[i]);
+    }
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(conv);
+    }
+}
+
 void bn_mul(Bignum* result, const Bignum* a0, const Bignum* a1) {
 
+    // a0 * a0 => a0^2
+    if (a0 == a1) {
+        bn_sqr(result, a0);
+        return;
+    }
+
     Bignum arg0 = {0};
     Bignum arg1 = {0};
 
@@ -274,7 +321,17 @@ void bn_mul(Bignum* result, const Bignum* a0, const Bignum* a1) {
     // a0 * 0 => 0
     // 0 * a1 => 0
     if (bn_equals_zero(&arg0) || bn_equals_zero(&arg1)) {
-        bni_write_parts1(result, 0, 0, BN_BASE_DEFAULT);
+        bni_write_parts1(result, 0, 0, arg0.base);
+        return;
+    }
+
+    // (+-a0) * (+-a0) => +-(a0^2)
+    if (bni_real_len(&arg0) == bni_real_len(&arg1)
+    && memcmp(arg0.digits_end, arg1.digits_end,
+              bni_real_len(&arg0) * sizeof(bn_digit_t)) == 0) {
+        uint8_t signbit = arg0.signbit ^ arg1.signbit;
+        bni_sqr(result, &arg0);
+        result->signbit = signbit;
         return;
     }
 
@@ -306,6 +363,69 @@ void bn_mul(Bignum* result, const Bignum* a0, const Bignum* a1) {
     bni_mul(result, &arg0, &arg1);
 }
 
+void bn_sqr(Bignum* result, const Bignum* a0) {
+
+    // 0^2 => 0
+    if (bn_equals_zero(a0)) {
+        bni_write_parts1(result, 0, 0, a0->base);
+        return;
+    }
+
+    // (-a0)^2 => a0^2
+    Bignum arg0 = *a0;
+    arg0.signbit = 0;
+
+    // compute a0^2
+    bni_sqr(result, &arg0);
+}
+
+bool bn_pow(Bignum* result, const Bignum* a0, const Bignum* a1) {
+
+    // a0 ^ (-a1) => not an integer
+    if (a1->signbit && !bn_equals_zero(a1)) {
+        return false;
+    }
+
+    uint64_t e;
+    if (!bni_to_u64(a1, &e)) {
+        return false;
+    }
+
+    // a0 ^ 0 => 1
+    if (e == 0) {
+        bni_write_parts1(result, 0, 1, a0->base);
+        return true;
+    }
+
+    // 0 ^ a1 => 0
+    // a0 ^ 1 => a0
+    if (bn_equals_zero(a0) || e == 1) {
+        bni_copy(result, a0);
+        return true;
+    }
+
+    // (-a0) ^ a1 => -(a0 ^ a1) if a1 is odd
+    uint8_t signbit = a0->signbit && (e & 1);
+    Bignum arg0 = *a0;
+    arg0.signbit = 0;
+
+    // (base^k) ^ a1 => base^(k*a1), just a shift
+    uint64_t k;
+    if (bni_is_base_power(&arg0, &k)) {
+        if (k != 0 && e > UINT64_MAX / k) {
+            return false;
+        }
+        bni_write_base_power(result, k * e, arg0.base);
+        result->signbit = signbit;
+        return true;
+    }
+
+    // compute a0 ^ a1
+    bni_pow(result, &arg0, e);
+    result->signbit = signbit;
+    return true;
+}
+
 bool bn_divmod(Bignum* result_div, Bignum* result_mod,
             const Bignum* a0,
             const Bignum* a1)
@@ -367,174 +487,780 @@ bool bn_divmod(Bignum* result_div, Bignum* result_mod,
         return true;
     }
 
-    // only supports Nx1 division for now
-    // TODO MxN
-    if (bni_real_len(&arg1) > 1) {
-        return false;
+    // past here the magnitudes are divided, the kernels only see those
+    arg0.signbit = 0;
+    arg1.signbit = 0;
+
+    // |a0| < |a1| => [0, |a0|]
+    if (bni_cmp_NxM(&arg0, &arg1) == -1) {
+        if (result_div != NULL) {
+            bni_write_parts1(result_div, 0, 0, arg0.base);
+        }
+        if (result_mod != NULL) {
+            bni_copy(result_mod, &arg0);
+        }
+        return true;
     }
 
-    // a0 // a1, a0 % a1
-    bni_divqr_Nx1(result_div, result_mod, &arg0, arg1.digits_end[0]);
+    // |a0| // |a1|, |a0| % |a1|
+    if (bni_real_len(&arg1) == 1) {
+        bni_divqr_Nx1(result_div, result_mod, &arg0, arg1.digits_end[0]);
+    } else {
+        bni_divqr_NxM(result_div, result_mod, &arg0, &arg1);
+    }
     return true;
 }
 
-uint64_t bni_real_len(const Bignum* b) {
-    return b->msd_pos + 1;
-}
-
-bool bni_is_valid(const Bignum* b) {
-    return b != NULL && b->digits_end != NULL;
-}
+// result = a0 + a1, or a0 - a1 if signbit is set
+static void bni_add_word(Bignum* result,
+                         const Bignum* a0,
+                         uint64_t a1,
+                         uint8_t signbit)
+{
+    // a1 does not fit in a digit => the general case
+    if (a1 >= BN_BASE[a0->base].real_base) {
+        Bignum arg1 = {0};
+        bni_write_u64(&arg1, signbit, a1, a0->base);
+        bn_add(result, a0, &arg1);
+        bni_try_free(&arg1);
+        return;
+    }
 
-void bni_freealloc(Bignum* out, size_t n_digits, bn_base_t base) {
-    bni_try_free(out);
-    *out = (Bignum){
-        .digits_end = BN_MALLOC(n_digits * sizeof(bn_digit_t)),
-        .capacity = n_digits
-    };
-    memset(out->digits_end, 0, n_digits * sizeof(bn_digit_t));
-    out->msd_pos = 0;
-    out->base = base;
-}
+    Bignum arg0 = *a0;
+    arg0.signbit = 0;
+    uint8_t a0_signbit = a0->signbit;
 
-void bni_append_zeros(Bignum* out, size_t n) {
+    // (+-a0) + (+-a1) => +-(a0 + a1)
+    if (a0_signbit == signbit) {
+        bni_add_1(result, &arg0, a1);
+        result->signbit = bn_equals_zero(result) ? 0 : signbit;
+        return;
+    }
 
-    uint64_t new_capacity = out->capacity + n;
-    Bignum result = {
-        .base = out->base,
-        .digits_end = BN_MALLOC(new_capacity * sizeof(bn_digit_t)),
-        .capacity = new_capacity,
-        .signbit = out->signbit
-    };
-    memset(result.digits_end, 0, new_capacity);
-    memcpy(result.digits_end, out->digits_end,
-           out->capacity * sizeof(bn_digit_t));
+    // a0 < a1 => +-(a1 - a0), where a0 is a single digit
+    if (bni_cmp_Nx1(&arg0, a1) == -1) {
+        bni_write_parts1(result, signbit, a1 - arg0.digits_end[0], a0->base);
+        return;
+    }
 
-    // do not bni_normalize(), instead:
-    result.msd_pos = out->msd_pos;
+    // compute +-(a0 - a1)
+    bni_sub_1(result, &arg0, a1);
+    result->signbit = bn_equals_zero(result) ? 0 : a0_signbit;
+}
 
-    bni_try_free(out);
-    *out = result;
+void bn_add_ui(Bignum* result, const Bignum* a0, uint64_t a1) {
+    bni_add_word(result, a0, a1, 0);
 }
 
-void bni_copy(Bignum* dest, const Bignum* src) {
+void bn_sub_ui(Bignum* result, const Bignum* a0, uint64_t a1) {
+    bni_add_word(result, a0, a1, 1);
+}
 
-    uint64_t real_len = bni_real_len(src);
-    Bignum result = {
-        .base = src->base,
-        .digits_end = BN_MALLOC(real_len * sizeof(bn_digit_t)),
-        .capacity = real_len,
-        .signbit = src->signbit
-    };
-    memcpy(result.digits_end, src->digits_end,
-           real_len * sizeof(bn_digit_t));
+void bn_mul_ui(Bignum* result, const Bignum* a0, uint64_t a1) {
 
-    bni_try_free(dest);
-    *dest = result;
-    bni_normalize(dest);
-}
+    // a1 does not fit in a digit => the general case
+    if (a1 >= BN_BASE[a0->base].real_base) {
+        Bignum arg1 = {0};
+        bni_write_u64(&arg1, 0, a1, a0->base);
+        bn_mul(result, a0, &arg1);
+        bni_try_free(&arg1);
+        return;
+    }
 
-void bni_convert(Bignum* dest, const Bignum* src, bn_base_t new_base) {
+    // a0 * 0 => 0
+    // 0 * a1 => 0
+    if (a1 == 0 || bn_equals_zero(a0)) {
+        bni_write_parts1(result, 0, 0, a0->base);
+        return;
+    }
 
-    bn_digit_t real_base = BN_BASE[new_base].real_base;
+    // (+-a0) * a1 => +-(a0 * a1)
+    Bignum arg0 = *a0;
+    arg0.signbit = 0;
+    uint8_t signbit = a0->signbit;
 
-    Bignum result = { .base = new_base };
+    bni_mul_1(result, &arg0, a1);
+    result->signbit = signbit;
+}
 
-    Bignum src_copy = {0};
-    bni_copy(&src_copy, src);
+bool bn_divmod_ui(Bignum* result_div, Bignum* result_mod,
+                  const Bignum* a0,
+                  uint64_t a1)
+{
+    // divmod(a0, 0) => divide/mod by zero error
+    if (a1 == 0) {
+        return false;
+    }
 
-    // current dest digit
-    Bignum cdd = {0};
+    // a1 does not fit in a digit => the general case
+    if (a1 >= BN_BASE[a0->base].real_base) {
+        Bignum arg1 = {0};
+        bni_write_u64(&arg1, 0, a1, a0->base);
+        bn_divmod(result_div, result_mod, a0, &arg1);
+        bni_try_free(&arg1);
+        return true;
+    }
 
-    while (true) {
+    // the same steps as bn_divmod, so it rounds the same
+    Bignum arg0 = *a0;
 
-        // allocate a new digit in the result
-        bni_append_zeros(&result, 1);
+    // divmod(0, a1) => [0, 0]
+    if (bn_equals_zero(&arg0)) {
+        if (result_div != NULL) {
+            bni_write_parts1(result_div, 0, 0, arg0.base);
+        }
+        if (result_mod != NULL) {
+            bni_write_parts1(result_mod, 0, 0, arg0.base);
+        }
+        return true;
+    }
 
-        // if the division result would be zero, src_copy is the final digit
-        if (bni_cmp_Nx1(&src_copy, new_base) == -1) {
-            result.digits_end[result.msd_pos] = src_copy.digits_end[0];
-            result.msd_pos++;
-            break;
+    // divmod(a0, 1) => [a0, 0]
+    if (a1 == 1) {
+        if (result_div != NULL) {
+            bni_copy(result_div, &arg0);
         }
+        if (result_mod != NULL) {
+            bni_write_parts1(result_mod, 0, 0, arg0.base);
+        }
+        return true;
+    }
+
+    int cmp = bn_cmp_ui(&arg0, a1);
 
-        // src_copy = src_copy / real_base
-        // cdd = src_copy % real_base
-        bni_divqr_Nx1(&src_copy, &cdd,
-                      &src_copy, real_base);
+    // a0 < a1 => [0, a0], every a0 < 0 included
+    if (cmp == -1) {
+        if (result_div != NULL) {
+            bni_write_parts1(result_div, 0, 0, arg0.base);
+        }
+        if (result_mod != NULL) {
+            bni_copy(result_mod, &arg0);
+        }
+        return true;
+    }
 
-        // append another digit
-        result.digits_end[result.msd_pos] = cdd.digits_end[cdd.msd_pos];
-        result.msd_pos++;
+    // a0 == a1 => [1, 0]
+    if (cmp == 0) {
+        if (result_div != NULL) {
+            bni_write_parts1(result_div, 0, 1, arg0.base);
+        }
+        if (result_mod != NULL) {
+            bni_write_parts1(result_mod, 0, 0, arg0.base);
+        }
+        return true;
     }
 
-    bni_try_free(&src_copy);
-    bni_try_free(dest);
-    *dest = result;
-    bni_normalize(dest);
+    // compute a0 // a1, a0 % a1
+    bni_divqr_Nx1(result_div, result_mod, &arg0, a1);
+    return true;
 }
 
-void bni_handle_bcm(Bignum* first_out, Bignum* last_out,
-                    const Bignum* first, const Bignum* last)
-{
-    // same base?
+int bn_cmp_ui(const Bignum* a0, uint64_t a1) {
 
-    if (first->base == last->base) {
-        bni_copy(first_out, first);
-        bni_copy(last_out, last);
-        return;
+    // a0 < 0 <= a1
+    if (a0->signbit && !bn_equals_zero(a0)) {
+        return -1;
     }
 
-    // different bases
+    // a0 does not fit in 64 bits => a0 > a1
+    uint64_t x;
+    if (!bni_to_u64(a0, &x)) {
+        return 1;
+    }
 
-    if (BN_CONFIG.base_coercion_mode == BC_BCM_FIRST) {
-        bni_copy(first_out, first);
-        bni_convert(last_out, last, first->base);
-        return;
+    if (x > a1) {
+        return 1;
+    } else if (x < a1) {
+        return -1;
     }
+    return 0;
+}
 
-    if (BN_CONFIG.base_coercion_mode == BC_BCM_LAST) {
-        bni_convert(first_out, first, last->base);
-        bni_copy(last_out, last);
-        return;
+bool bn_isqrt(Bignum* result, const Bignum* a0) {
+    return bn_iroot(result, a0, 2);
+}
+
+bool bn_iroot(Bignum* result, const Bignum* a0, uint64_t n) {
+
+    // 0th root => error
+    // even root of a0 < 0 => not an integer
+    if (n == 0 || (n % 2 == 0 && a0->signbit && !bn_equals_zero(a0))) {
+        return false;
     }
 
-    if (BN_CONFIG.base_coercion_mode == BC_BCM_DEFAULT) {
-        bni_convert(first_out, first, BN_BASE_DEFAULT);
-        bni_convert(last_out, last, BN_BASE_DEFAULT);
-        return;
+    // iroot(0, n) => 0
+    // iroot(a0, 1) => a0
+    if (bn_equals_zero(a0) || n == 1) {
+        bni_copy(result, a0);
+        return true;
     }
+
+    // iroot(-a0, n) => -iroot(a0, n) for odd n
+    uint8_t signbit = a0->signbit;
+    Bignum arg0 = *a0;
+    arg0.signbit = 0;
+
+    // compute iroot(a0, n)
+    bni_iroot(result, &arg0, n);
+    result->signbit = signbit;
+    return true;
 }
 
-void bni_try_free(Bignum* out) {
-    if (!bni_is_valid(out)) {
-        return;
+bool bn_fact(Bignum* result, const Bignum* a0) {
+
+    // (-a0)! => error
+    if (a0->signbit && !bn_equals_zero(a0)) {
+        return false;
     }
-    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
-        BN_FREE(out->digits_end);
+
+    uint64_t n;
+    if (!bni_to_u64(a0, &n) || n > UINT32_MAX) {
+        return false;
     }
-    *out = (Bignum){0};
+
+    // compute a0!
+    bni_fact(result, n, a0->base);
+    return true;
 }
 
-void bni_normalize(Bignum* out) {
+bool bn_binom(Bignum* result, const Bignum* a0, const Bignum* a1) {
 
-    // single digit, nothing to do
-    if (out->capacity == 1) {
-        out->msd_pos = 0;
-        return;
+    // binom(-a0, a1) => error
+    if (a0->signbit && !bn_equals_zero(a0)) {
+        return false;
     }
 
-    out->msd_pos = out->capacity - 1;
+    uint64_t n;
+    if (!bni_to_u64(a0, &n)) {
+        return false;
+    }
 
-    // strip leading zeroes
-    while (out->msd_pos != 0 && out->digits_end[out->msd_pos] == 0) {
-        out->msd_pos--;
+    // binom(a0, -a1) => 0
+    // binom(a0, a1 > a0) => 0
+    uint64_t k;
+    if ((a1->signbit && !bn_equals_zero(a1))
+    || !bni_to_u64(a1, &k) || k > n) {
+        bni_write_parts1(result, 0, 0, a0->base);
+        return true;
+    }
+
+    // binom(a0, a1) == binom(a0, a0 - a1)
+    k = bnu_min(k, n - k);
+    if (n > UINT32_MAX && k > UINT32_MAX) {
+        return false;
     }
+
+    // compute binom(a0, a1)
+    bni_binom(result, n, k, a0->base);
+    return true;
 }
 
-bool bni_write_str(Bignum* out, const char* str, size_t len, bn_base_t base) {
+bool bn_fib(Bignum* result, const Bignum* a0) {
 
-    if (!bnu_base_valid(base) || str == NULL || len == 0) {
+    uint64_t n;
+    if (!bni_to_u64(a0, &n)) {
+        return false;
+    }
+
+    // fib(0) => 0
+    if (n == 0) {
+        bni_write_parts1(result, 0, 0, a0->base);
+        return true;
+    }
+
+    // compute fib(a0)
+    Bignum f1 = {0};
+    bni_fib(result, &f1, n, a0->base);
+    bni_try_free(&f1);
+
+    // fib(-a0) => -fib(a0) if a0 is even
+    result->signbit = a0->signbit && (n % 2 == 0);
+    return true;
+}
+
+bool bn_lucas(Bignum* result, const Bignum* a0) {
+
+    uint64_t n;
+    if (!bni_to_u64(a0, &n)) {
+        return false;
+    }
+
+    // lucas(0) => 2
+    if (n == 0) {
+        bni_write_parts1(result, 0, 2, a0->base);
+        return true;
+    }
+
+    // lucas(a0) = fib(a0) + 2 * fib(a0 - 1)
+    Bignum f = {0};
+    Bignum f1 = {0};
+    bni_fib(&f, &f1, n, a0->base);
+    bni_add(&f1, &f1, &f1);
+    bni_add(result, &f, &f1);
+    bn_free(&f, &f1);
+
+    // lucas(-a0) => -lucas(a0) if a0 is odd
+    result->signbit = a0->signbit && (n % 2 == 1);
+    return true;
+}
+
+bool bn_pi(Bignum* result, const Bignum* a0) {
+
+    uint64_t digits;
+    if ((a0->signbit && !bn_equals_zero(a0))
+    || !bni_to_u64(a0, &digits) || digits > UINT32_MAX) {
+        return false;
+    }
+
+    // compute pi * base^a0
+    bni_pi(result, digits, a0->base);
+    return true;
+}
+
+bool bn_e(Bignum* result, const Bignum* a0) {
+
+    uint64_t digits;
+    if ((a0->signbit && !bn_equals_zero(a0))
+    || !bni_to_u64(a0, &digits) || digits > UINT32_MAX) {
+        return false;
+    }
+
+    // compute e * base^a0
+    bni_e(result, digits, a0->base);
+    return true;
+}
+
+// modular arithmetic
+
+bool bn_mont_init(BignumMont* mont, const Bignum* m) {
+
+    // the modulus has to be > 1
+    if (m->signbit || bni_cmp_Nx1(m, 1) <= 0) {
+        return false;
+    }
+
+    // -m^-1 mod real_base only exists if gcd(m, real_base) == 1
+    int64_t real_base = BN_BASE[m->base].real_base;
+    int64_t old_r = m->digits_end[0], r = real_base;
+    int64_t old_s = 1, s = 0;
+    while (r != 0) {
+        int64_t q = old_r / r;
+        int64_t t = old_r - q * r;
+        old_r = r;
+        r = t;
+        t = old_s - q * s;
+        old_s = s;
+        s = t;
+    }
+    if (old_r != 1) {
+        return false;
+    }
+
+    // old_s = m^-1 mod real_base (up to sign)
+    int64_t inv = old_s % real_base;
+    if (inv < 0) {
+        inv += real_base;
+    }
+
+    *mont = (BignumMont){0};
+    bni_copy(&mont->m, m);
+    mont->n = bni_real_len(m);
+    mont->m_inv = (inv == 0) ? 0 : real_base - inv;
+
+    // R^2 = real_base^2n = fake_base^(2n*width)
+    Bignum r_squared = {0};
+    bni_write_base_power(&r_squared,
+        2 * mont->n * BN_BASE[m->base].width, m->base);
+    bn_divmod(NULL, &mont->r2, &r_squared, m);
+    bni_try_free(&r_squared);
+
+    return true;
+}
+
+void bn_mont_free(BignumMont* mont) {
+    bn_free(&mont->m, &mont->r2);
+    *mont = (BignumMont){0};
+}
+
+bool bn_barrett_init(BignumBarrett* br, const Bignum* m) {
+
+    if (m->signbit || bn_equals_zero(m)) {
+        return false;
+    }
+
+    *br = (BignumBarrett){0};
+    bni_copy(&br->m, m);
+    br->n = bni_real_len(m);
+
+    // mu = real_base^2n // m
+    bni_recip(&br->mu, m);
+
+    return true;
+}
+
+void bn_barrett_free(BignumBarrett* br) {
+    bn_free(&br->m, &br->mu);
+    *br = (BignumBarrett){0};
+}
+
+void bn_barrett_reduce(Bignum* result,
+                       const BignumBarrett* br,
+                       const Bignum* a0)
+{
+    Bignum arg0 = *a0;
+    arg0.signbit = 0;
+
+    // other bases, or too big for one barrett step => long division
+    if (a0->base != br->m.base || bni_real_len(a0) > 2 * br->n) {
+        bn_divmod(NULL, result, &arg0, &br->m);
+    } else {
+        bni_barrett_reduce(result, br, &arg0);
+    }
+
+    // (-a0) % m => m - (a0 % m), keeping the base of a0
+    if (a0->signbit && !bn_equals_zero(result)) {
+        bn_sub(result, result, &br->m);
+        bn_neg(result, result);
+    }
+}
+
+bool bn_powmod(Bignum* result,
+               const Bignum* a0,
+               const Bignum* a1,
+               const Bignum* m)
+{
+    // negative exponent or modulus => error
+    if ((a1->signbit && !bn_equals_zero(a1))
+    || m->signbit || bn_equals_zero(m)) {
+        return false;
+    }
+
+    Bignum arg0 = {0};
+    Bignum mod = {0};
+
+    bni_handle_bcm(&arg0, &mod, a0, m);
+
+    // a0 % 1 => 0
+    if (bni_cmp_Nx1(&mod, 1) == 0) {
+        bni_write_parts1(result, 0, 0, arg0.base);
+        bn_free(&arg0, &mod);
+        return true;
+    }
+
+    // a0 ^ 0 => 1
+    if (bn_equals_zero(a1)) {
+        bni_write_parts1(result, 0, 1, arg0.base);
+        bn_free(&arg0, &mod);
+        return true;
+    }
+
+    // reduce a0 into [0, m)
+    uint8_t negative = arg0.signbit;
+    arg0.signbit = 0;
+    bn_divmod(NULL, &arg0, &arg0, &mod);
+    if (negative && !bn_equals_zero(&arg0)) {
+        bni_sub(&arg0, &mod, &arg0);
+    }
+
+    BignumMont mont;
+    if (bn_mont_init(&mont, &mod)) {
+        bni_mont_powmod(result, &mont, &arg0, a1);
+        bn_mont_free(&mont);
+        bn_free(&arg0, &mod);
+        return true;
+    }
+
+    // no montgomery form for this modulus
+    // square and multiply, reducing with a division after every step
+    Bignum exp = {0};
+    bn_convert(&exp, a1, 2);
+
+    Bignum acc = {0};
+    bni_write_parts1(&acc, 0, 1, arg0.base);
+
+    for (size_t i = bni_real_len(&exp); i-- > 0;) {
+        for (int bit = BN_BASE[2].width - 1; bit >= 0; bit--) {
+            bni_sqr(&acc, &acc);
+            if ((exp.digits_end[i] >> bit) & 1) {
+                bni_mul(&acc, &acc, &arg0);
+            }
+            bn_divmod(NULL, &acc, &acc, &mod);
+        }
+    }
+
+    bni_try_free(result);
+    *result = acc;
+    bn_free(&arg0, &mod, &exp);
+    return true;
+}
+
+void bn_gcd(Bignum* result, const Bignum* a0, const Bignum* a1) {
+
+    Bignum arg0 = {0};
+    Bignum arg1 = {0};
+
+    bni_handle_bcm(&arg0, &arg1, a0, a1);
+    arg0.signbit = 0;
+    arg1.signbit = 0;
+
+    // larger one first
+    if (bni_cmp_NxM(&arg0, &arg1) < 0) {
+        Bignum temp = arg0;
+        arg0 = arg1;
+        arg1 = temp;
+    }
+
+    bni_gcd(result, NULL, &arg0, &arg1);
+    bn_free(&arg0, &arg1);
+}
+
+void bn_lcm(Bignum* result, const Bignum* a0, const Bignum* a1) {
+
+    // lcm(0, a1) => 0
+    // lcm(a0, 0) => 0
+    if (bn_equals_zero(a0) || bn_equals_zero(a1)) {
+        bni_write_parts1(result, 0, 0, a0->base);
+        return;
+    }
+
+    // |a0| // gcd(a0, a1) * |a1|
+    Bignum g = {0};
+    bn_gcd(&g, a0, a1);
+
+    Bignum arg0 = *a0;
+    Bignum arg1 = *a1;
+    arg0.signbit = 0;
+    arg1.signbit = 0;
+
+    Bignum q = {0};
+    bn_divmod(&q, NULL, &arg0, &g);
+    bn_mul(result, &q, &arg1);
+
+    bn_free(&g, &q);
+}
+
+bool bn_invmod(Bignum* result, const Bignum* a0, const Bignum* m) {
+
+    if (m->signbit || bn_equals_zero(m)) {
+        return false;
+    }
+
+    Bignum arg0 = {0};
+    Bignum mod = {0};
+
+    bni_handle_bcm(&arg0, &mod, a0, m);
+
+    // reduce a0 into [0, m)
+    uint8_t negative = arg0.signbit;
+    arg0.signbit = 0;
+    bn_divmod(NULL, &arg0, &arg0, &mod);
+    if (negative && !bn_equals_zero(&arg0)) {
+        bni_sub(&arg0, &mod, &arg0);
+    }
+
+    // s * a0 == gcd(m, a0) (mod m), the inverse exists if that gcd is 1
+    Bignum g = {0};
+    Bignum s = {0};
+    bni_gcd(&g, &s, &mod, &arg0);
+
+    bool ok = (bni_cmp_Nx1(&g, 1) == 0);
+    if (ok) {
+        // a0 % 1 => 0
+        if (bni_cmp_Nx1(&mod, 1) == 0) {
+            bni_write_parts1(result, 0, 0, arg0.base);
+        } else {
+            // s % m, in [0, m)
+            negative = s.signbit;
+            s.signbit = 0;
+            bn_divmod(NULL, &s, &s, &mod);
+            if (negative && !bn_equals_zero(&s)) {
+                bni_sub(&s, &mod, &s);
+            }
+            bni_copy(result, &s);
+        }
+    }
+
+    bn_free(&arg0, &mod, &g, &s);
+    return ok;
+}
+
+uint64_t bni_real_len(const Bignum* b) {
+    return b->msd_pos + 1;
+}
+
+bool bni_is_valid(const Bignum* b) {
+    return b != NULL && b->digits_end != NULL;
+}
+
+void bni_freealloc(Bignum* out, size_t n_digits, bn_base_t base) {
+    bni_try_free(out);
+    *out = (Bignum){
+        .digits_end = BN_MALLOC(n_digits * sizeof(bn_digit_t)),
+        .capacity = n_digits
+    };
+    memset(out->digits_end, 0, n_digits * sizeof(bn_digit_t));
+    out->msd_pos = 0;
+    out->base = base;
+}
+
+void bni_append_zeros(Bignum* out, size_t n) {
+
+    uint64_t new_capacity = out->capacity + n;
+    Bignum result = {
+        .base = out->base,
+        .digits_end = BN_MALLOC(new_capacity * sizeof(bn_digit_t)),
+        .capacity = new_capacity,
+        .signbit = out->signbit
+    };
+    memset(result.digits_end, 0, new_capacity);
+    memcpy(result.digits_end, out->digits_end,
+           out->capacity * sizeof(bn_digit_t));
+
+    // do not bni_normalize(), instead:
+    result.msd_pos = out->msd_pos;
+
+    bni_try_free(out);
+    *out = result;
+}
+
+void bni_copy(Bignum* dest, const Bignum* src) {
+
+    uint64_t real_len = bni_real_len(src);
+    Bignum result = {
+        .base = src->base,
+        .digits_end = BN_MALLOC(real_len * sizeof(bn_digit_t)),
+        .capacity = real_len,
+        .signbit = src->signbit
+    };
+    memcpy(result.digits_end, src->digits_end,
+           real_len * sizeof(bn_digit_t));
+
+    bni_try_free(dest);
+    *dest = result;
+    bni_normalize(dest);
+}
+
+void bni_borrow(Bignum* dest, const Bignum* src) {
+    bni_try_free(dest);
+    *dest = *src;
+    dest->borrowed = 1;
+}
+
+void bni_unshare(Bignum* b) {
+    if (b->borrowed) {
+        bni_copy(b, b);
+    }
+}
+
+void bni_convert(Bignum* dest, const Bignum* src, bn_base_t new_base) {
+
+    if (bni_real_len(src) >= BN_CONVERT_DC_THRESHOLD) {
+        bni_convert_dc(dest, src, new_base);
+        return;
+    }
+
+    // every real_base is between 2^26 and 2^32, so each digit of src
+    // turns into less than 2 new ones
+    size_t n = bni_real_len(src);
+    Bignum result = {0};
+    bni_freealloc(&result, 2 * n, new_base);
+
+    // divided into new digits in place
+    bn_digit_t* x = BN_MALLOC(n * sizeof(bn_digit_t));
+    memcpy(x, src->digits_end, n * sizeof(bn_digit_t));
+
+    bnl_convert(result.digits_end, 2 * n, x, n,
+                BN_BASE[src->base].real_base,
+                BN_BASE[new_base].real_base);
+
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(x);
+    }
+
+    bni_try_free(dest);
+    result.signbit = src->signbit;
+    *dest = result;
+    bni_normalize(dest);
+}
+
+void bni_handle_bcm(Bignum* first_out, Bignum* last_out,
+                    const Bignum* first, const Bignum* last)
+{
+    // same base?
+
+    // an operand that keeps its base is borrowed, not copied
+
+    if (first->base == last->base) {
+        bni_borrow(first_out, first);
+        bni_borrow(last_out, last);
+        return;
+    }
+
+    // different bases
+
+    if (BN_CONFIG.base_coercion_mode == BC_BCM_FIRST) {
+        bni_borrow(first_out, first);
+        bni_convert(last_out, last, first->base);
+        return;
+    }
+
+    if (BN_CONFIG.base_coercion_mode == BC_BCM_LAST) {
+        bni_convert(first_out, first, last->base);
+        bni_borrow(last_out, last);
+        return;
+    }
+
+    if (BN_CONFIG.base_coercion_mode == BC_BCM_DEFAULT) {
+        bni_convert(first_out, first, BN_BASE_DEFAULT);
+        bni_convert(last_out, last, BN_BASE_DEFAULT);
+        return;
+    }
+}
+
+bn_base_t bni_bcm_base(const Bignum* args, size_t n) {
+    bn_base_t base = args[0].base;
+    for (size_t i = 1; i < n; i++) {
+        if (args[i].base == base) {
+            continue;
+        }
+        if (BN_CONFIG.base_coercion_mode == BC_BCM_LAST) {
+            base = args[i].base;
+        } else if (BN_CONFIG.base_coercion_mode == BC_BCM_DEFAULT) {
+            base = BN_BASE_DEFAULT;
+        }
+    }
+    return base;
+}
+
+void bni_try_free(Bignum* out) {
+    if (!bni_is_valid(out)) {
+        return;
+    }
+    if (BN_CONFIG.no_free == BC_NF_DISABLED && !out->borrowed) {
+        BN_FREE(out->digits_end);
+    }
+    *out = (Bignum){0};
+}
+
+void bni_normalize(Bignum* out) {
+
+    // single digit, nothing to do
+    if (out->capacity == 1) {
+        out->msd_pos = 0;
+        return;
+    }
+
+    out->msd_pos = out->capacity - 1;
+
+    // strip leading zeroes
+    while (out->msd_pos != 0 && out->digits_end[out->msd_pos] == 0) {
+        out->msd_pos--;
+    }
+}
+
+bool bni_write_str(Bignum* out, const char* str, size_t len, bn_base_t base) {
+
+    if (!bnu_base_valid(base) || str == NULL || len == 0) {
         return false;
     }
 
@@ -545,558 +1271,2799 @@ bool bni_write_str(Bignum* out, const char* str, size_t len, bn_base_t base) {
         str += 1;
         len -= 1;
 
-        // "-" is not a number
-        if (len == 0) {
-            return false;
+        // "-" is not a number
+        if (len == 0) {
+            return false;
+        }
+    }
+
+    // must be all valid digits in the specified base
+    for (const char* s = str; s != str + len; s++) {
+        if (!bnu_digit_valid(*s, base, NULL)) {
+            return false;
+        }
+    }
+
+    // how many leading zeroes are needed to round off a full digit?
+
+    uint32_t mp = BN_BASE[base].width;
+
+    // avoid wasting space - add 0 bytes if len already rounded off
+    uint32_t n_leading_zeroes = (len % mp == 0) ? 0 : (mp - (len % mp));
+    uint32_t new_len = len + n_leading_zeroes;
+
+    // if needed, copy the string, padding with leading zeroes
+
+    char* new_str;
+
+    if (n_leading_zeroes == 0) {
+        new_str = bnu_strndup(str, len);
+    } else {
+        new_str = BN_MALLOC((new_len + 1) * sizeof(char));
+        memset(new_str, 0, new_len + 1);
+        memset(new_str, '0', n_leading_zeroes);
+
+        // copy all the "real" digits from the old string
+        memcpy(new_str + n_leading_zeroes, str, len);
+    }
+
+    // parse the number, mp characters at a time
+
+    // guaranteed: new_len % mp == 0 -- very important
+    uint32_t num_digits = new_len / mp;
+
+    Bignum result = {
+        .base = base,
+        .digits_end = BN_MALLOC(num_digits * sizeof(uint32_t)),
+        .capacity = num_digits,
+        .signbit = (is_negative) ? 1 : 0,
+    };
+    memset(result.digits_end, 0, num_digits * sizeof(uint32_t));
+
+    // loop in reverse order
+    uint32_t* dp = &result.digits_end[result.capacity - 1];
+    char* sp = new_str;
+
+    while (sp < new_str + len) {
+
+        // mp characters => 1 digit
+        if (!bnu_parse_digit(sp, 0, mp, base, dp)) {
+            // nth digit conversion failed
+            bni_try_free(&result);
+            return false;
+        }
+
+        sp += mp;
+        dp -= 1;
+    }
+
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(new_str);
+    }
+
+    bni_try_free(out);
+    *out = result;
+    bni_normalize(out);
+    return true;
+}
+
+void bni_write_base_power(Bignum* out, uint64_t k, bn_base_t base) {
+
+    uint8_t width = BN_BASE[base].width;
+
+    bn_digit_t msd = 1;
+    for (uint64_t i = 0; i < k % width; i++) {
+        msd *= base;
+    }
+
+    bni_freealloc(out, k / width + 1, base);
+    out->digits_end[k / width] = msd;
+    bni_normalize(out);
+}
+
+void bni_write_u64(Bignum* out,
+                   uint8_t signbit,
+                   uint64_t value,
+                   bn_base_t base)
+{
+    uint64_t real_base = BN_BASE[base].real_base;
+
+    // a u64 is at most 3 digits in any base
+    bni_freealloc(out, 3, base);
+    for (size_t i = 0; i < 3; i++) {
+        out->digits_end[i] = value % real_base;
+        value /= real_base;
+    }
+    bni_normalize(out);
+    out->signbit = bn_equals_zero(out) ? 0 : signbit;
+}
+
+bool bni_write_parts1(Bignum* out,
+                      uint8_t signbit,
+                      bn_digit_t d0,
+                      bn_base_t base)
+{
+    if (!bnu_digit_in_range(d0, base)) {
+        return false;
+    }
+
+    bni_freealloc(out, 1, base);
+    out->signbit = signbit;
+    out->digits_end[0] = d0;
+    bni_normalize(out);
+    return true;
+
+}
+
+bool bni_write_parts2(Bignum* out,
+                      uint8_t signbit,
+                      bn_digit_t d0, bn_digit_t d1,
+                      bn_base_t base)
+{
+    if (!bnu_digit_in_range(d0, base)
+    || !bnu_digit_in_range(d1, base)) {
+        return false;
+    }
+
+    bni_freealloc(out, 2, base);
+    out->signbit = signbit;
+    out->digits_end[1] = d0;
+    out->digits_end[0] = d1;
+    bni_normalize(out);
+    return true;
+
+}
+
+bool bni_to_u64(const Bignum* b, uint64_t* out) {
+
+    uint64_t real_base = BN_BASE[b->base].real_base;
+    uint64_t result = 0;
+
+    for (size_t i = b->msd_pos; &b->digits_end[i] >= b->digits_end; i--) {
+        if (result > (UINT64_MAX - b->digits_end[i]) / real_base) {
+            return false;
+        }
+        result = result * real_base + b->digits_end[i];
+    }
+
+    *out = result;
+    return true;
+}
+
+bool bni_is_base_power(const Bignum* b, uint64_t* k_out) {
+
+    // every digit below the MSD must be zero
+    for (size_t i = 0; i < b->msd_pos; i++) {
+        if (b->digits_end[i] != 0) {
+            return false;
+        }
+    }
+
+    // and the MSD must be a power of fake_base
+    bn_digit_t msd = b->digits_end[b->msd_pos];
+    if (msd == 0) {
+        return false;
+    }
+
+    uint64_t k = 0;
+    while (msd % b->base == 0) {
+        msd /= b->base;
+        k += 1;
+    }
+    if (msd != 1) {
+        return false;
+    }
+
+    *k_out = k + (uint64_t)b->msd_pos * BN_BASE[b->base].width;
+    return true;
+}
+
+size_t bni_print(const Bignum* b, bool explicit_base, bool use_uppercase) {
+    if (b->digits_end == NULL || b->capacity == 0) {
+        fputs("(null)", stdout);
+        return 6;
+    }
+
+    if (bn_equals_zero(b)) {
+        fputs("0", stdout);
+        return 1;
+    }
+
+    // number of characters printed
+    size_t nc = 0;
+
+    if (b->signbit) {
+        fputs("-", stdout);
+        nc += 1;
+    }
+
+    // digits go out through a fixed buffer, one chunk at a time, so a huge
+    // number is never formatted into one big string
+    char chunk[BN_PRINT_CHUNK];
+    size_t used = 0;
+    bn_base_t base = b->base;
+    uint8_t width = BN_BASE[base].width;
+
+    for (size_t i = b->msd_pos + 1; i-- > 0;) {
+
+        if (used + width > BN_PRINT_CHUNK) {
+            fwrite(chunk, 1, used, stdout);
+            used = 0;
+        }
+
+        // leading digit without leading 0s, the rest padded to width
+        bn_digit_t d = b->digits_end[i];
+        size_t n = width;
+        if (i == b->msd_pos) {
+            n = 0;
+            for (bn_digit_t t = d; t > 0; t /= base) {
+                n += 1;
+            }
+        }
+
+        for (size_t j = n; j-- > 0;) {
+            // +1 because BN_BASE is zero indexed
+            chunk[used + j] = BN_BASE[1 + d % base].last_digit[use_uppercase];
+            d /= base;
+        }
+        used += n;
+        nc += n;
+    }
+
+    fwrite(chunk, 1, used, stdout);
+
+    if (explicit_base) {
+        nc += printf("_%u", b->base);
+    }
+
+    return nc;
+}
+
+void bni_dump(const Bignum* b) {
+    if (b->digits_end == NULL) {
+        printf("Bignum{\n"
+            "  .base=%lu,\n"
+            "  .signbit=%lu,\n"
+            "  .capacity=%llu,\n"
+            "  rlen=%lu,\n"
+            "  .digits=[]}\n",
+        (unsigned long)b->base,
+        (unsigned long)b->signbit,
+        (unsigned long long)b->capacity,
+        (unsigned long)bni_real_len(b));
+    } else {
+
+        printf("Bignum{\n"
+            "  .base=%lu,\n"
+            "  .signbit=%lu,\n"
+            "  .capacity=%llu,\n"
+            "  rlen=%lu,\n"
+            "  .digits=[\n"
+            "    <mem_start>\n",
+        (unsigned long)b->base,
+        (unsigned long)b->signbit,
+        (unsigned long long)b->capacity,
+        (unsigned long)bni_real_len(b));
+
+        for (uint64_t i = 0; i < b->capacity; i++) {
+            printf(
+            "    %0*lu,%s\n",
+            BN_BASE[b->base].width,
+            (unsigned long) b->digits_end[i],
+            i == b->msd_pos ? " <-- MSD" : "");
+        }
+
+        printf(
+            "    <mem_end>\n"
+            "  ]}\n");
+    }
+}
+
+int bni_cmp_Nx1(const Bignum* a0, bn_digit_t a1) {
+    if (bni_real_len(a0) > 1) return 1;
+    if (a0->digits_end[0] > a1) return 1;
+    if (a0->digits_end[0] < a1) return -1;
+    return 0;
+}
+
+int bni_cmp_NxM(const Bignum* a0, const Bignum* a1) {
+    if (a0->signbit && !a1->signbit) {
+        return -1; // a0 < 0 < a1
+    } else if (!a0->signbit && a1->signbit) {
+        return 1; // a1 < 0 < a0
+    }
+
+    // a0, a1 have same sign
+    int sign = a0->signbit ? -1 : 1;
+
+    // compare real lengths, accounting for where start is not just capacity
+    size_t len0 = bni_real_len(a0);
+    size_t len1 = bni_real_len(a1);
+    if (len0 > len1) {
+        return sign * 1;
+    } else if (len0 < len1) {
+        return sign * -1;
+    }
+
+    // compare digitwise MSD -> LSD
+    return sign * bnl_cmp(a0->digits_end, a1->digits_end, len0);
+}
+
+void bni_lshift(Bignum* out, const Bignum* a0, size_t n) {
+    if (bn_equals_zero(a0)) {
+        bni_copy(out, a0);
+        return;
+    }
+
+    size_t rlen0 = bni_real_len(a0);
+    size_t new_len = rlen0 + n;
+
+    Bignum result = {0};
+    bni_freealloc(&result, new_len, a0->base);
+
+    bn_digit_t* dest = result.digits_end + n;
+    bn_digit_t* src = a0->digits_end;
+
+    for (size_t i = 0; i < rlen0; i++) {
+        dest[i] = src[i];
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        result.digits_end[i] = 0;
+    }
+
+    result.msd_pos = new_len - 1;
+    result.signbit = a0->signbit;
+
+    bni_try_free(out);
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_mul_base_power(Bignum* out, const Bignum* a0, uint64_t k) {
+    if (bn_equals_zero(a0)) {
+        bni_copy(out, a0);
+        return;
+    }
+
+    bn_base_t base = a0->base;
+    uint64_t real_base = BN_BASE[base].real_base;
+    uint8_t width = BN_BASE[base].width;
+
+    // fake_base^k = real_base^(k / width) * small
+    uint64_t small = 1;
+    for (uint64_t i = 0; i < k % width; i++) {
+        small *= base;
+    }
+
+    size_t len = bni_real_len(a0);
+    size_t shift = k / width;
+
+    Bignum result = {0};
+    bni_freealloc(&result, shift + len + 1, base);
+
+    uint64_t carry = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint64_t t = small * a0->digits_end[i] + carry;
+        result.digits_end[shift + i] = t % real_base;
+        carry = t / real_base;
+    }
+    result.digits_end[shift + len] = carry;
+    result.signbit = a0->signbit;
+
+    bni_try_free(out);
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_div_base_power(Bignum* out, const Bignum* a0, uint64_t k) {
+    bn_base_t base = a0->base;
+    uint64_t real_base = BN_BASE[base].real_base;
+    uint8_t width = BN_BASE[base].width;
+
+    size_t len = bni_real_len(a0);
+    size_t shift = k / width;
+
+    if (shift >= len) {
+        bni_write_parts1(out, 0, 0, base);
+        return;
+    }
+
+    uint64_t small = 1;
+    for (uint64_t i = 0; i < k % width; i++) {
+        small *= base;
+    }
+
+    Bignum result = {0};
+    bni_freealloc(&result, len - shift, base);
+
+    // MSD -> LSD, the remainder stays below small
+    uint64_t rem = 0;
+    for (size_t i = len - shift; i-- > 0;) {
+        uint64_t t = rem * real_base + a0->digits_end[shift + i];
+        result.digits_end[i] = t / small;
+        rem = t % small;
+    }
+
+    bni_try_free(out);
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_rshift(Bignum* out, const Bignum* a0, size_t n) {
+    if (bn_equals_zero(a0)) {
+        bni_copy(out, a0);
+        return;
+    }
+
+    size_t rlen0 = bni_real_len(a0);
+
+    if (n >= rlen0) {
+        bni_write_parts1(out, 0, 0, a0->base);
+        return;
+    }
+
+    size_t new_len = rlen0 - n;
+
+    Bignum result = {0};
+    bni_freealloc(&result, new_len, a0->base);
+
+    bn_digit_t* dest = result.digits_end;
+    bn_digit_t* src = a0->digits_end + n;
+
+    for (size_t i = 0; i < new_len; i++) {
+        dest[i] = src[i];
+    }
+
+    result.msd_pos = new_len - 1;
+    result.signbit = a0->signbit;
+
+    bni_try_free(out);
+    *out = result;
+    bni_normalize(out);
+}
+
+// out already has the digits of a and may write over them, with room for n
+static bool bni_reuses(const Bignum* out, const Bignum* a, size_t n) {
+    return bni_is_valid(out)
+        && !out->borrowed
+        && out->digits_end == a->digits_end
+        && out->capacity >= n;
+}
+
+void bni_neg(Bignum* out, const Bignum* a0) {
+
+    // -x in place just flips the sign
+    if (bni_reuses(out, a0, bni_real_len(a0))) {
+        out->msd_pos = a0->msd_pos;
+        out->signbit = !a0->signbit;
+        return;
+    }
+
+    Bignum result = {0};
+    bni_copy(&result, a0);
+    result.signbit = !result.signbit;
+
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_add(Bignum* out, const Bignum* a0, const Bignum* a1) {
+    // carry algorithm
+
+    // swap the numbers such that a0->len >= a1->len
+    // bnl_add wants the longer one first
+    // also guarantees `max(len0, len1) == len0`
+    if (bni_real_len(a0) < bni_real_len(a1)) {
+        const Bignum* temp = a0;
+        a0 = a1;
+        a1 = temp;
+    }
+
+    Bignum result = {0};
+    size_t len0 = bni_real_len(a0);
+    size_t len1 = bni_real_len(a1);
+    size_t max_len = 1 + len0; // +1 for possible carry
+
+    // digit i is read before it's written, so out can be either operand
+    bool in_place = bni_reuses(out, a0, max_len) || bni_reuses(out, a1, max_len);
+    if (in_place) {
+        result = *out;
+        result.base = a0->base;
+    } else {
+        bni_freealloc(&result, max_len, a0->base);
+    }
+
+    bn_digit_t real_base = BN_BASE[result.base].real_base;
+
+    result.digits_end[len0] = bnl_add(result.digits_end,
+                                      a0->digits_end, len0,
+                                      a1->digits_end, len1,
+                                      real_base);
+    result.signbit = 0;
+
+    if (!in_place) {
+        bni_try_free(out);
+    }
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_sum(Bignum* out, const Bignum* args, size_t n) {
+
+    bn_base_t base = args[0].base;
+    int64_t real_base = BN_BASE[base].real_base;
+
+    // a column of up to 2^31 digits fits in an int64, and since every
+    // real_base is over 2^27 the total fits in 2 more digits than the
+    // longest term
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t l = bni_real_len(&args[i]);
+        len = (l > len) ? l : len;
+    }
+    len += 2;
+
+    int64_t* acc = BN_MALLOC(len * sizeof(int64_t));
+    memset(acc, 0, len * sizeof(int64_t));
+
+    for (size_t i = 0; i < n; i++) {
+        const bn_digit_t* d = args[i].digits_end;
+        size_t l = bni_real_len(&args[i]);
+        if (args[i].signbit) {
+            for (size_t j = 0; j < l; j++) {
+                acc[j] -= d[j];
+            }
+        } else {
+            for (size_t j = 0; j < l; j++) {
+                acc[j] += d[j];
+            }
+        }
+    }
+
+    // one carry pass with floored division, every column ends up in
+    // [0, real_base) and the carry out of the top is 0 or -1
+    int64_t carry = 0;
+    for (size_t j = 0; j < len; j++) {
+        int64_t v = acc[j] + carry;
+        carry = v / real_base;
+        v %= real_base;
+        if (v < 0) {
+            v += real_base;
+            carry -= 1;
+        }
+        acc[j] = v;
+    }
+
+    // negative total - the columns hold real_base^len - |total|, negating
+    // them and carrying again leaves |total|
+    uint8_t signbit = (carry < 0);
+    if (signbit) {
+        carry = 0;
+        for (size_t j = 0; j < len; j++) {
+            int64_t v = carry - acc[j];
+            carry = (v < 0) ? -1 : 0;
+            acc[j] = v - carry * real_base;
+        }
+    }
+
+    // pack the columns into digits in place, digit j only overwrites
+    // columns below j, which have been read already
+    bn_digit_t* digits = (bn_digit_t*)acc;
+    for (size_t j = 0; j < len; j++) {
+        bn_digit_t d = acc[j];
+        digits[j] = d;
+    }
+
+    Bignum result = {
+        .digits_end = digits,
+        .capacity = len,
+        .base = base
+    };
+    bni_normalize(&result);
+    result.signbit = bn_equals_zero(&result) ? 0 : signbit;
+
+    bni_try_free(out);
+    *out = result;
+}
+
+void bni_sub(Bignum* out, const Bignum* a0, const Bignum* a1) {
+    // borrow algorithm
+
+    // a0 < a1 => -(a1 - a0)
+    if (bn_cmp(a0, a1) == -1) {
+        bni_sub(out, a1, a0);
+        out->signbit = !out->signbit;
+        return;
+    }
+
+    // now assume a0 > a1
+
+    Bignum result = {0};
+    size_t len0 = bni_real_len(a0);
+    size_t len1 = bni_real_len(a1);
+    bool in_place = bni_reuses(out, a0, len0) || bni_reuses(out, a1, len0);
+    if (in_place) {
+        result = *out;
+        result.base = a0->base;
+        result.signbit = 0;
+    } else {
+        bni_freealloc(&result, len0, a0->base);
+    }
+
+    bn_digit_t real_base = BN_BASE[result.base].real_base;
+
+    bnl_sub(result.digits_end,
+            a0->digits_end, len0,
+            a1->digits_end, len1,
+            real_base);
+
+    if (!in_place) {
+        bni_try_free(out);
+    }
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_add_1(Bignum* out, const Bignum* a0, bn_digit_t a1) {
+
+    Bignum result = {0};
+    size_t len = bni_real_len(a0);
+    bool in_place = bni_reuses(out, a0, len + 1);
+    if (in_place) {
+        result = *out;
+        result.base = a0->base;
+    } else {
+        bni_freealloc(&result, len + 1, a0->base);
+    }
+
+    result.digits_end[len] = bnl_add_1(result.digits_end,
+                                       a0->digits_end, len,
+                                       a1,
+                                       BN_BASE[a0->base].real_base);
+    result.signbit = 0;
+
+    if (!in_place) {
+        bni_try_free(out);
+    }
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_sub_1(Bignum* out, const Bignum* a0, bn_digit_t a1) {
+
+    Bignum result = {0};
+    size_t len = bni_real_len(a0);
+    bool in_place = bni_reuses(out, a0, len);
+    if (in_place) {
+        result = *out;
+        result.base = a0->base;
+    } else {
+        bni_freealloc(&result, len, a0->base);
+    }
+
+    bnl_sub_1(result.digits_end,
+              a0->digits_end, len,
+              a1,
+              BN_BASE[a0->base].real_base);
+    result.signbit = 0;
+
+    if (!in_place) {
+        bni_try_free(out);
+    }
+    *out = result;
+    bni_normalize(out);
+}
+
+// limb arrays - nothing here allocates, see bignum.h
+
+size_t bnl_real_len(const bn_digit_t* a, size_t n) {
+    while (n > 1 && a[n - 1] == 0) {
+        n--;
+    }
+    return n;
+}
+
+int bnl_cmp(const bn_digit_t* a, const bn_digit_t* b, size_t n) {
+    for (size_t i = n; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return (a[i] > b[i]) ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+bn_digit_t bnl_add_1(bn_digit_t* r,
+                     const bn_digit_t* a, size_t n,
+                     bn_digit_t x,
+                     bn_digit_t real_base)
+{
+    uint64_t carry = x;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t sum = (uint64_t)a[i] + carry;
+        carry = (sum >= real_base);
+        r[i] = carry ? sum - real_base : sum;
+    }
+    return carry;
+}
+
+bn_digit_t bnl_sub_1(bn_digit_t* r,
+                     const bn_digit_t* a, size_t n,
+                     bn_digit_t x,
+                     bn_digit_t real_base)
+{
+    int64_t borrow = x;
+    for (size_t i = 0; i < n; i++) {
+        int64_t diff = (int64_t)a[i] - borrow;
+        borrow = (diff < 0);
+        r[i] = borrow ? diff + real_base : diff;
+    }
+    return borrow;
+}
+
+bn_digit_t bnl_add(bn_digit_t* r,
+                   const bn_digit_t* a, size_t an,
+                   const bn_digit_t* b, size_t bn,
+                   bn_digit_t real_base)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < bn; i++) {
+        uint64_t sum = (uint64_t)a[i] + b[i] + carry;
+        carry = (sum >= real_base);
+        r[i] = carry ? sum - real_base : sum;
+    }
+    return bnl_add_1(r + bn, a + bn, an - bn, carry, real_base);
+}
+
+bn_digit_t bnl_sub(bn_digit_t* r,
+                   const bn_digit_t* a, size_t an,
+                   const bn_digit_t* b, size_t bn,
+                   bn_digit_t real_base)
+{
+    int64_t borrow = 0;
+    for (size_t i = 0; i < bn; i++) {
+        int64_t diff = (int64_t)a[i] - b[i] - borrow;
+        borrow = (diff < 0);
+        r[i] = borrow ? diff + real_base : diff;
+    }
+    return bnl_sub_1(r + bn, a + bn, an - bn, borrow, real_base);
+}
+
+bn_digit_t bnl_mul_1(bn_digit_t* r,
+                     const bn_digit_t* a, size_t n,
+                     bn_digit_t x,
+                     bn_digit_t real_base)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t product = (uint64_t)a[i] * x + carry;
+        r[i] = product % real_base;
+        carry = product / real_base;
+    }
+    return carry;
+}
+
+bn_digit_t bnl_divrem_1(bn_digit_t* q,
+                        const bn_digit_t* a, size_t n,
+                        bn_digit_t d,
+                        bn_digit_t real_base)
+{
+    // MSD -> LSD, every step divides {rem}{a[i]} by d
+    uint64_t rem = 0;
+    for (size_t i = n; i-- > 0;) {
+        uint64_t cur = rem * real_base + a[i];
+        if (q != NULL) {
+            q[i] = cur / d;
+        }
+        rem = cur % d;
+    }
+    return rem;
+}
+
+// r = a * b, schoolbook
+// assumes an >= bn, r has room for an + bn digits, does not alias a or b
+static void bnl_mul_basecase(bn_digit_t* r,
+                             const bn_digit_t* a, size_t an,
+                             const bn_digit_t* b, size_t bn,
+                             bn_digit_t real_base)
+{
+    memset(r, 0, (an + bn) * sizeof(bn_digit_t));
+
+    for (size_t j = 0; j < bn; j++) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < an; i++) {
+            uint64_t product = (uint64_t)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = product % real_base;
+            carry = product / real_base;
+        }
+        r[j + an] = carry;
+    }
+}
+
+size_t bnl_mul_scratch_len(size_t an) {
+    size_t len = 0;
+    while (an >= BN_MUL_KARATSUBA_THRESHOLD) {
+        size_t h = an - an / 2;
+        len += 6 * (h + 1);
+        an = h + 1;
+    }
+    return len;
+}
+
+void bnl_mul(bn_digit_t* r,
+             const bn_digit_t* a, size_t an,
+             const bn_digit_t* b, size_t bn,
+             bn_digit_t real_base,
+             bn_digit_t* scratch)
+{
+    if (bn < BN_MUL_KARATSUBA_THRESHOLD) {
+        bnl_mul_basecase(r, a, an, b, bn, real_base);
+        return;
+    }
+
+    size_t k = an / 2;
+
+    // unbalanced - a in pieces of bn digits
+    if (bn <= k) {
+        bn_digit_t* t = scratch;    // one partial product, 2bn digits
+        bn_digit_t* next = t + 2 * bn;
+
+        memset(r, 0, (an + bn) * sizeof(bn_digit_t));
+        for (size_t i = 0; i < an; i += bn) {
+            size_t c = bnu_min(bn, an - i);
+            if (c == bn) {
+                bnl_mul(t, a + i, c, b, bn, real_base, next);
+            } else {
+                bnl_mul(t, b, bn, a + i, c, real_base, next);
+            }
+            bnl_add(r + i, r + i, an + bn - i, t, c + bn, real_base);
+        }
+        return;
+    }
+
+    size_t h = an - k;      // high half of a, h >= k
+    size_t bh = bn - k;     // high half of b, 0 < bh <= h
+    size_t tbn = bnu_max(k, bh) + 1;
+
+    bn_digit_t* ta = scratch;           // a0 + a1, h + 1 digits
+    bn_digit_t* tb = ta + (h + 1);      // b0 + b1, tbn digits
+    bn_digit_t* tm = tb + (h + 1);      // (a0 + a1)(b0 + b1), h + 1 + tbn
+    bn_digit_t* next = tm + 2 * (h + 1);
+
+    ta[h] = bnl_add(ta, a + k, h, a, k, real_base);
+    if (bh >= k) {
+        tb[bh] = bnl_add(tb, b + k, bh, b, k, real_base);
+    } else {
+        tb[k] = bnl_add(tb, b, k, b + k, bh, real_base);
+    }
+
+    bnl_mul(r, a, k, b, k, real_base, next);
+    bnl_mul(r + 2 * k, a + k, h, b + k, bh, real_base, next);
+    bnl_mul(tm, ta, h + 1, tb, tbn, real_base, next);
+
+    // middle term, never negative
+    size_t tml = h + 1 + tbn;
+    bnl_sub(tm, tm, tml, r, 2 * k, real_base);
+    bnl_sub(tm, tm, tml, r + 2 * k, h + bh, real_base);
+
+    // drop zero digits that would run past the end of r
+    tml = bnl_real_len(tm, tml);
+    bnl_add(r + k, r + k, h + bn, tm, tml, real_base);
+}
+
+// r = a^2, schoolbook, every cross product a[i] * a[j] is computed once
+// assumes r has room for 2n digits, does not alias a
+static void bnl_sqr_basecase(bn_digit_t* r,
+                             const bn_digit_t* a, size_t n,
+                             bn_digit_t real_base)
+{
+    memset(r, 0, 2 * n * sizeof(bn_digit_t));
+
+    // sum of a[i] * a[j] for i < j
+    for (size_t i = 0; i + 1 < n; i++) {
+        uint64_t carry = 0;
+        for (size_t j = i + 1; j < n; j++) {
+            uint64_t product = (uint64_t)a[i] * a[j] + r[i + j] + carry;
+            r[i + j] = product % real_base;
+            carry = product / real_base;
+        }
+        r[i + n] = carry;
+    }
+
+    // double it and add the squares on the diagonal
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t lo = (uint64_t)a[i] * a[i] + 2 * (uint64_t)r[2 * i] + carry;
+        r[2 * i] = lo % real_base;
+        uint64_t hi = 2 * (uint64_t)r[2 * i + 1] + lo / real_base;
+        r[2 * i + 1] = hi % real_base;
+        carry = hi / real_base;
+    }
+}
+
+size_t bnl_sqr_scratch_len(size_t n) {
+    size_t len = 0;
+    while (n >= BN_SQR_KARATSUBA_THRESHOLD) {
+        size_t h = n - n / 2;
+        len += 3 * (h + 1);
+        n = h + 1;
+    }
+    return len;
+}
+
+void bnl_sqr(bn_digit_t* r,
+             const bn_digit_t* a, size_t n,
+             bn_digit_t real_base,
+             bn_digit_t* scratch)
+{
+    if (n < BN_SQR_KARATSUBA_THRESHOLD) {
+        bnl_sqr_basecase(r, a, n, real_base);
+        return;
+    }
+
+    size_t k = n / 2;   // low half
+    size_t h = n - k;   // high half, h >= k
+
+    bn_digit_t* t = scratch;            // a0 + a1, h + 1 digits
+    bn_digit_t* tt = t + (h + 1);       // (a0 + a1)^2, 2h + 2 digits
+    bn_digit_t* next = tt + 2 * (h + 1);
+
+    t[h] = bnl_add(t, a + k, h, a, k, real_base);
+
+    bnl_sqr(r, a, k, real_base, next);
+    bnl_sqr(r + 2 * k, a + k, h, real_base, next);
+    bnl_sqr(tt, t, h + 1, real_base, next);
+
+    // middle term, never negative
+    bnl_sub(tt, tt, 2 * h + 2, r, 2 * k, real_base);
+    bnl_sub(tt, tt, 2 * h + 2, r + 2 * k, 2 * h, real_base);
+
+    // fits because the full square is exactly 2n digits
+    bnl_add(r + k, r + k, k + 2 * h, tt, 2 * h + 2, real_base);
+}
+
+size_t bnl_divrem_scratch_len(size_t an, size_t bn) {
+    return (an + 1) + bn;
+}
+
+void bnl_divrem(bn_digit_t* q, bn_digit_t* r,
+                const bn_digit_t* a, size_t an,
+                const bn_digit_t* b, size_t bn,
+                bn_digit_t real_base,
+                bn_digit_t* scratch)
+{
+    if (bn == 1) {
+        bn_digit_t rem = bnl_divrem_1(q, a, an, b[0], real_base);
+        if (r != NULL) {
+            r[0] = rem;
+        }
+        return;
+    }
+
+    // knuth's algorithm D, one quotient digit per step
+
+    // normalize so the top digit of the divisor is >= real_base / 2
+    // this keeps each estimated quotient digit within 2 of the real one
+    bn_digit_t d = real_base / ((uint64_t)b[bn - 1] + 1);
+
+    bn_digit_t* un = scratch;           // a * d, an + 1 digits
+    bn_digit_t* vn = un + (an + 1);     // b * d, bn digits
+
+    un[an] = bnl_mul_1(un, a, an, d, real_base);
+    bnl_mul_1(vn, b, bn, d, real_base);
+
+    for (size_t j = an - bn + 1; j-- > 0;) {
+
+        // estimate from the top two digits, then correct with the third
+        uint64_t num = (uint64_t)un[j + bn] * real_base + un[j + bn - 1];
+        uint64_t qhat = num / vn[bn - 1];
+        uint64_t rhat = num % vn[bn - 1];
+
+        while (qhat >= real_base
+        || qhat * vn[bn - 2] > rhat * real_base + un[j + bn - 2]) {
+            qhat -= 1;
+            rhat += vn[bn - 1];
+            if (rhat >= real_base) {
+                break;
+            }
+        }
+
+        // un[j..j+bn] -= qhat * vn
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < bn; i++) {
+            uint64_t p = qhat * vn[i] + carry;
+            carry = p / real_base;
+            int64_t t = (int64_t)un[i + j] - (int64_t)(p % real_base) - borrow;
+            borrow = (t < 0);
+            un[i + j] = borrow ? t + (int64_t)real_base : t;
+        }
+        int64_t t = (int64_t)un[j + bn] - (int64_t)carry - borrow;
+
+        if (t < 0) {
+            // qhat was one too large, add the divisor back
+            un[j + bn] = t + real_base;
+            qhat -= 1;
+            bn_digit_t c = bnl_add(un + j, un + j, bn, vn, bn, real_base);
+            un[j + bn] = (un[j + bn] + c) % real_base;
+        } else {
+            un[j + bn] = t;
+        }
+
+        if (q != NULL) {
+            q[j] = qhat;
+        }
+    }
+
+    // remainder = un / d
+    if (r != NULL) {
+        bnl_divrem_1(r, un, bn, d, real_base);
+    }
+}
+
+void bnl_convert(bn_digit_t* out, size_t out_len,
+                 bn_digit_t* x, size_t n,
+                 bn_digit_t x_real_base,
+                 bn_digit_t real_base)
+{
+    // one new digit at a time, x shrinks in place until it's 0
+    size_t i = 0;
+    n = bnl_real_len(x, n);
+    while (n > 1 || x[0] != 0) {
+        out[i] = bnl_divrem_1(x, x, n, real_base, x_real_base);
+        i += 1;
+        n = bnl_real_len(x, n);
+    }
+    memset(out + i, 0, (out_len - i) * sizeof(bn_digit_t));
+}
+
+// parallel multiply - the top few levels of the karatsuba recursion hand
+// two of their three subproducts to BN_CONFIG.spawn_hook and compute the
+// third themselves, every subproduct gets its own scratch
+
+// one subproduct, b == NULL means a^2
+typedef struct {
+    bn_digit_t* r;
+    const bn_digit_t* a;
+    size_t an;
+    const bn_digit_t* b;
+    size_t bn;
+    bn_digit_t real_base;
+    unsigned depth;     // levels left to split
+} BnlMulTask;
+
+// levels to split, with fanout tasks per level, so every thread has a
+// couple of tasks to steal
+static unsigned bnl_par_depth(size_t fanout) {
+    if (BN_CONFIG.spawn_hook == NULL || BN_CONFIG.n_threads < 2) {
+        return 0;
+    }
+
+    unsigned depth = 0;
+    for (size_t n_tasks = 1; n_tasks < 2 * BN_CONFIG.n_threads; n_tasks *= fanout) {
+        depth += 1;
+    }
+    return depth;
+}
+
+// t on this thread, with its own scratch
+static void bnl_mul_serial(const BnlMulTask* t) {
+    size_t scratch_len = (t->b == NULL)
+        ? bnl_sqr_scratch_len(t->an)
+        : bnl_mul_scratch_len(t->an);
+
+    bn_digit_t* scratch = NULL;
+    if (scratch_len > 0) {
+        scratch = BN_MALLOC(scratch_len * sizeof(bn_digit_t));
+    }
+
+    if (t->b == NULL) {
+        bnl_sqr(t->r, t->a, t->an, t->real_base, scratch);
+    } else {
+        bnl_mul(t->r, t->a, t->an, t->b, t->bn, t->real_base, scratch);
+    }
+
+    if (scratch != NULL && BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(scratch);
+    }
+}
+
+// same contract as bnl_mul and bnl_sqr, minus the scratch
+static void bnl_mul_par(void* arg) {
+    const BnlMulTask* t = arg;
+    bool sqr = (t->b == NULL);
+    bn_digit_t* r = t->r;
+    const bn_digit_t* a = t->a;
+    const bn_digit_t* b = t->b;
+    size_t an = t->an;
+    size_t bn = sqr ? an : t->bn;
+    bn_digit_t real_base = t->real_base;
+
+    size_t k = an / 2;
+
+    if (t->depth == 0 || bn < BN_MUL_PARALLEL_THRESHOLD) {
+        bnl_mul_serial(t);
+        return;
+    }
+
+    // unbalanced - a in pieces of bn digits, one after another, each piece
+    // split on its own
+    if (!sqr && bn <= k) {
+        bn_digit_t* p = BN_MALLOC(2 * bn * sizeof(bn_digit_t));
+
+        memset(r, 0, (an + bn) * sizeof(bn_digit_t));
+        for (size_t i = 0; i < an; i += bn) {
+            size_t c = bnu_min(bn, an - i);
+            BnlMulTask piece = (c == bn)
+                ? (BnlMulTask){ p, a + i, c, b, bn, real_base, t->depth }
+                : (BnlMulTask){ p, b, bn, a + i, c, real_base, t->depth };
+            bnl_mul_par(&piece);
+            bnl_add(r + i, r + i, an + bn - i, p, c + bn, real_base);
+        }
+
+        if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+            BN_FREE(p);
+        }
+        return;
+    }
+
+    size_t h = an - k;
+    size_t bh = sqr ? h : bn - k;
+    size_t tbn = sqr ? h + 1 : bnu_max(k, bh) + 1;
+
+    bn_digit_t* ta = BN_MALLOC((3 * (h + 1) + tbn) * sizeof(bn_digit_t));
+    bn_digit_t* tb = ta + (h + 1);
+    bn_digit_t* tm = tb + (h + 1);
+    size_t tml = h + 1 + tbn;
+
+    ta[h] = bnl_add(ta, a + k, h, a, k, real_base);
+    if (sqr) {
+        tb = NULL;
+    } else if (bh >= k) {
+        tb[bh] = bnl_add(tb, b + k, bh, b, k, real_base);
+    } else {
+        tb[k] = bnl_add(tb, b, k, b + k, bh, real_base);
+    }
+
+    BnlMulTask sub[3] = {
+        { r, a, k, b, k, real_base, t->depth - 1 },
+        { r + 2 * k, a + k, h, sqr ? NULL : b + k, bh, real_base, t->depth - 1 },
+        { tm, ta, h + 1, tb, tbn, real_base, t->depth - 1 }
+    };
+
+    void* low = BN_CONFIG.spawn_hook(bnl_mul_par, &sub[0]);
+    void* high = BN_CONFIG.spawn_hook(bnl_mul_par, &sub[1]);
+    bnl_mul_par(&sub[2]);
+    BN_CONFIG.join_hook(high);
+    BN_CONFIG.join_hook(low);
+
+    // middle term, never negative
+    bnl_sub(tm, tm, tml, r, 2 * k, real_base);
+    bnl_sub(tm, tm, tml, r + 2 * k, h + bh, real_base);
+
+    // drop zero digits that would run past the end of r
+    tml = bnl_real_len(tm, tml);
+    bnl_add(r + k, r + k, h + bn, tm, tml, real_base);
+
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(ta);
+    }
+}
+
+void bni_mul(Bignum* out, const Bignum* a0, const Bignum* a1) {
+
+    // longer operand first
+    if (bni_real_len(a0) < bni_real_len(a1)) {
+        const Bignum* temp = a0;
+        a0 = a1;
+        a1 = temp;
+    }
+
+    size_t len0 = bni_real_len(a0);
+    size_t len1 = bni_real_len(a1);
+
+    Bignum result = {0};
+    bni_freealloc(&result, len0 + len1, a0->base);
+
+    unsigned depth = bnl_par_depth(3);
+    if (depth > 0 && len1 >= BN_MUL_PARALLEL_THRESHOLD) {
+        bnl_mul_par(&(BnlMulTask){
+            result.digits_end,
+            a0->digits_end, len0,
+            a1->digits_end, len1,
+            BN_BASE[a0->base].real_base, depth
+        });
+    } else {
+        bn_digit_t* scratch = NULL;
+        size_t scratch_len = bnl_mul_scratch_len(len0);
+        if (len1 >= BN_MUL_KARATSUBA_THRESHOLD && scratch_len > 0) {
+            scratch = BN_MALLOC(scratch_len * sizeof(bn_digit_t));
+        }
+
+        bnl_mul(result.digits_end,
+                a0->digits_end, len0,
+                a1->digits_end, len1,
+                BN_BASE[a0->base].real_base, scratch);
+
+        if (scratch != NULL && BN_CONFIG.no_free == BC_NF_DISABLED) {
+            BN_FREE(scratch);
+        }
+    }
+
+    bni_try_free(out);
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_mul_1(Bignum* out, const Bignum* a0, bn_digit_t a1) {
+
+    Bignum result = {0};
+    size_t len = bni_real_len(a0);
+    bool in_place = bni_reuses(out, a0, len + 1);
+    if (in_place) {
+        result = *out;
+        result.base = a0->base;
+    } else {
+        bni_freealloc(&result, len + 1, a0->base);
+    }
+
+    result.digits_end[len] = bnl_mul_1(result.digits_end,
+                                       a0->digits_end, len,
+                                       a1,
+                                       BN_BASE[a0->base].real_base);
+    result.signbit = 0;
+
+    if (!in_place) {
+        bni_try_free(out);
+    }
+    *out = result;
+    bni_normalize(out);
+}
+
+void bni_sqr(Bignum* out, const Bignum* a0) {
+
+    size_t n = bni_real_len(a0);
+
+    Bignum result = {0};
+    bni_freealloc(&result, 2 * n, a0->base);
+
+    unsigned depth = bnl_par_depth(3);
+    if (depth > 0 && n >= BN_MUL_PARALLEL_THRESHOLD) {
+        bnl_mul_par(&(BnlMulTask){
+            result.digits_end,
+            a0->digits_end, n,
+            NULL, n,
+            BN_BASE[a0->base].real_base, depth
+        });
+    } else {
+        bn_digit_t* scratch = NULL;
+        size_t scratch_len = bnl_sqr_scratch_len(n);
+        if (scratch_len > 0) {
+            scratch = BN_MALLOC(scratch_len * sizeof(bn_digit_t));
+        }
+
+        bnl_sqr(result.digits_end, a0->digits_end, n,
+                BN_BASE[a0->base].real_base, scratch);
+
+        if (scratch != NULL && BN_CONFIG.no_free == BC_NF_DISABLED) {
+            BN_FREE(scratch);
+        }
+    }
+
+    bni_try_free(out);
+    *out = result;
+    bni_normalize(out);
+}
+
+// divide and conquer conversion - with R = the new real_base and powers[i] =
+// R^(2^i) in the old base, x < powers[level + 1] splits into
+// x = hi * powers[level] + lo, and hi and lo both fit in 2^level new digits
+
+// one half being converted, into out[0, out_len), zero padded
+typedef struct {
+    bn_digit_t* out;
+    size_t out_len;
+    Bignum x;               // owned, consumed by the conversion
+    const Bignum* powers;
+    size_t level;
+    bn_digit_t real_base;   // R
+    unsigned depth;         // levels left to split across threads
+} BnlConvertTask;
+
+// x one new digit at a time, as in bni_convert, in x's own digits
+static void bnl_convert_basecase(BnlConvertTask* t) {
+    bni_unshare(&t->x);
+    bnl_convert(t->out, t->out_len,
+                t->x.digits_end, bni_real_len(&t->x),
+                BN_BASE[t->x.base].real_base,
+                t->real_base);
+    bni_try_free(&t->x);
+}
+
+static void bnl_convert_dc(void* arg) {
+    BnlConvertTask* t = arg;
+
+    // x < powers[level], nothing to split off at this level
+    while (t->level > 0 && bni_cmp_NxM(&t->x, &t->powers[t->level]) == -1) {
+        t->level -= 1;
+    }
+
+    const Bignum* p = &t->powers[t->level];
+    if (bni_real_len(&t->x) < BN_CONVERT_DC_THRESHOLD
+    || bni_real_len(p) < 2
+    || bni_cmp_NxM(&t->x, p) == -1) {
+        bnl_convert_basecase(t);
+        return;
+    }
+
+    size_t m = (size_t)1 << t->level;
+    unsigned depth = (t->depth > 0) ? t->depth - 1 : 0;
+
+    BnlConvertTask lo = {
+        t->out, m, {0}, t->powers, t->level, t->real_base, depth
+    };
+    BnlConvertTask hi = {
+        t->out + m, t->out_len - m, {0}, t->powers, t->level, t->real_base,
+        depth
+    };
+    bni_divqr_NxM(&hi.x, &lo.x, &t->x, p);
+    bni_try_free(&t->x);
+
+    if (t->depth > 0) {
+        void* handle = BN_CONFIG.spawn_hook(bnl_convert_dc, &hi);
+        bnl_convert_dc(&lo);
+        BN_CONFIG.join_hook(handle);
+    } else {
+        bnl_convert_dc(&lo);
+        bnl_convert_dc(&hi);
+    }
+}
+
+void bni_convert_dc(Bignum* dest, const Bignum* src, bn_base_t new_base) {
+
+    bn_digit_t real_base = BN_BASE[new_base].real_base;
+
+    BnlConvertTask t = {
+        .real_base = real_base,
+        .depth = bnl_par_depth(2)
+    };
+    bni_borrow(&t.x, src);
+    t.x.signbit = 0;
+
+    // powers[0] = R, ..., powers[n - 1]^2 > x - going by lengths, so the
+    // square itself is never computed
+    size_t capacity = 8;
+    Bignum* powers = BN_MALLOC(capacity * sizeof(Bignum));
+    powers[0] = (Bignum){0};
+    bni_write_u64(&powers[0], 0, real_base, src->base);
+    size_t n = 1;
+    while (2 * (bni_real_len(&powers[n - 1]) - 1) < bni_real_len(&t.x)) {
+        if (n == capacity) {
+            capacity *= 2;
+            powers = BN_REALLOC(powers, capacity * sizeof(Bignum));
+        }
+        powers[n] = (Bignum){0};
+        bni_sqr(&powers[n], &powers[n - 1]);
+        n += 1;
+    }
+
+    // x < R^(2^n)
+    Bignum result = {0};
+    t.out_len = (size_t)1 << n;
+    bni_freealloc(&result, t.out_len, new_base);
+    t.out = result.digits_end;
+    t.powers = powers;
+    t.level = n - 1;
+
+    bnl_convert_dc(&t);
+
+    for (size_t i = 0; i < n; i++) {
+        bni_try_free(&powers[i]);
+    }
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(powers);
+    }
+
+    bni_try_free(dest);
+    result.msd_pos = t.out_len - 1;
+    result.signbit = src->signbit;
+    *dest = result;
+    bni_normalize(dest);
+}
+
+void bni_pow(Bignum* out, const Bignum* a0, uint64_t e) {
+    // left-to-right binary powering
+
+    Bignum result = {0};
+    bni_copy(&result, a0);
+
+    // skip the leading 1 bit, it's the copy above
+    int bit = 63;
+    while (!((e >> bit) & 1)) {
+        bit--;
+    }
+
+    for (bit -= 1; bit >= 0; bit--) {
+        bni_sqr(&result, &result);
+        if ((e >> bit) & 1) {
+            bni_mul(&result, &result, a0);
+        }
+    }
+
+    bni_try_free(out);
+    *out = result;
+}
+
+void bni_iroot(Bignum* out, const Bignum* a0, uint64_t k) {
+
+    size_t n = bni_real_len(a0);
+    bn_base_t base = a0->base;
+    uint64_t real_base = BN_BASE[base].real_base;
+
+    // a0 < 2^32n => the root is 1
+    if (k >= 32 * (uint64_t)n) {
+        bni_write_parts1(out, 0, 1, base);
+        return;
+    }
+
+    // start from any s >= the root, the closer the better
+    Bignum s = {0};
+    size_t j = (n - 1) / (2 * k);
+
+    if (j == 0) {
+        // a0 has at most 2k digits so the root is below real_base^2, start
+        // just above the floating point estimate
+        size_t used = bnu_min(n, 3);
+        double top = 0;
+        for (size_t i = 0; i < used; i++) {
+            top = top * real_base + a0->digits_end[n - 1 - i];
+        }
+        double est = exp((log(top) + (n - used) * log(real_base)) / k);
+        est = est * (1 + 1e-9) + 2;
+
+        uint64_t guess = (est < 1.8e19) ? (uint64_t)est : UINT64_MAX;
+        bni_write_u64(&s, 0, guess, base);
+    } else {
+        // root of the top digits, which is about the top half of the root
+        Bignum top = {0};
+        Bignum one = {0};
+        bni_rshift(&top, a0, k * j);
+        bni_iroot(&s, &top, k);
+
+        // (s + 1) * real_base^j >= the root of a0
+        bni_write_parts1(&one, 0, 1, base);
+        bni_add(&s, &s, &one);
+        bni_lshift(&s, &s, j);
+        bn_free(&top, &one);
+    }
+
+    // s^k > a0 either way, so take newton steps from above
+    // s = ((k-1)*s + a0 // s^(k-1)) // k never goes below the root, and it
+    // has reached it as soon as s^k <= a0
+    Bignum p = {0};
+    Bignum t = {0};
+    Bignum q = {0};
+    Bignum k_minus_1 = {0};
+    Bignum k_big = {0};
+    bni_write_u64(&k_minus_1, 0, k - 1, base);
+    bni_write_u64(&k_big, 0, k, base);
+
+    bni_pow(&p, &s, k - 1);
+    while (true) {
+        bn_divmod(&q, NULL, a0, &p);
+        bni_mul(&t, &s, &k_minus_1);
+        bni_add(&t, &t, &q);
+        bn_divmod(&s, NULL, &t, &k_big);
+
+        bni_pow(&p, &s, k - 1);
+        if (k == 2) {
+            bni_sqr(&t, &s);
+        } else {
+            bni_mul(&t, &p, &s);
+        }
+        if (bni_cmp_NxM(&t, a0) <= 0) {
+            break;
+        }
+    }
+
+    bn_free(&p, &t, &q, &k_minus_1, &k_big);
+    bni_try_free(out);
+    *out = s;
+}
+
+// primes <= n, in order, with the count written to count_out
+// sieve of eratosthenes over the odd numbers
+static uint64_t* bnl_primes(uint64_t n, size_t* count_out) {
+
+    // composite[i] is 1 if 2i + 1 is composite
+    size_t n_odd = n / 2 + 1;
+    uint8_t* composite = BN_MALLOC(n_odd);
+    memset(composite, 0, n_odd);
+
+    for (uint64_t p = 3; p * p <= n; p += 2) {
+        if (!composite[p / 2]) {
+            for (uint64_t q = p * p; q <= n; q += 2 * p) {
+                composite[q / 2] = 1;
+            }
+        }
+    }
+
+    size_t count = (n >= 2);
+    for (uint64_t p = 3; p <= n; p += 2) {
+        count += !composite[p / 2];
+    }
+
+    uint64_t* primes = BN_MALLOC((count + 1) * sizeof(uint64_t));
+    size_t i = 0;
+    if (n >= 2) {
+        primes[i++] = 2;
+    }
+    for (uint64_t p = 3; p <= n; p += 2) {
+        if (!composite[p / 2]) {
+            primes[i++] = p;
+        }
+    }
+
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(composite);
+    }
+
+    *count_out = count;
+    return primes;
+}
+
+// out = xs[0] * xs[1] * ... * xs[n-1]
+// neighbours are multiplied together while they fit a u64, then the rest
+// goes up a balanced product tree, so every big multiplication is between
+// two numbers of about the same size. overwrites xs
+static void bni_product_u64(Bignum* out, uint64_t* xs, size_t n,
+                            bn_base_t base)
+{
+    if (n == 0) {
+        bni_write_parts1(out, 0, 1, base);
+        return;
+    }
+
+    size_t packed = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (packed > 0 && xs[packed - 1] <= UINT64_MAX / xs[i]) {
+            xs[packed - 1] *= xs[i];
+        } else {
+            xs[packed++] = xs[i];
+        }
+    }
+
+    if (packed == 1) {
+        bni_write_u64(out, 0, xs[0], base);
+        return;
+    }
+
+    Bignum lo = {0};
+    Bignum hi = {0};
+    bni_product_u64(&lo, xs, packed / 2, base);
+    bni_product_u64(&hi, xs + packed / 2, packed - packed / 2, base);
+    bni_mul(out, &lo, &hi);
+    bn_free(&lo, &hi);
+}
+
+// out = product of primes[i] ^ exps[i]
+// the primes are grouped by each bit of their exponents, so it's
+// one square-and-multiply over the bits with a product tree per bit
+static void bni_prime_power_product(Bignum* out,
+                                    const uint64_t* primes,
+                                    const uint64_t* exps,
+                                    size_t count,
+                                    bn_base_t base)
+{
+    uint64_t max_exp = 0;
+    for (size_t i = 0; i < count; i++) {
+        max_exp = bnu_max(max_exp, exps[i]);
+    }
+
+    uint64_t* group = BN_MALLOC((count + 1) * sizeof(uint64_t));
+
+    Bignum result = {0};
+    Bignum t = {0};
+    bni_write_parts1(&result, 0, 1, base);
+
+    for (int bit = 63; bit >= 0; bit--) {
+        if ((max_exp >> bit) == 0) {
+            continue;
+        }
+
+        bni_sqr(&result, &result);
+
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            if ((exps[i] >> bit) & 1) {
+                group[n++] = primes[i];
+            }
         }
-    }
 
-    // must be all valid digits in the specified base
-    for (const char* s = str; s != str + len; s++) {
-        if (!bnu_digit_valid(*s, base, NULL)) {
-            return false;
+        if (n != 0) {
+            bni_product_u64(&t, group, n, base);
+            bni_mul(&result, &result, &t);
         }
     }
 
-    // how many leading zeroes are needed to round off a full digit?
-
-    uint32_t mp = BN_BASE[base].width;
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(group);
+    }
 
-    // avoid wasting space - add 0 bytes if len already rounded off
-    uint32_t n_leading_zeroes = (len % mp == 0) ? 0 : (mp - (len % mp));
-    uint32_t new_len = len + n_leading_zeroes;
+    bni_try_free(&t);
+    bni_try_free(out);
+    *out = result;
+    bni_normalize(out);
+}
 
-    // if needed, copy the string, padding with leading zeroes
+void bni_fact(Bignum* out, uint64_t n, bn_base_t base) {
 
-    char* new_str;
+    // 0! = 1! = 1
+    if (n < 2) {
+        bni_write_parts1(out, 0, 1, base);
+        return;
+    }
 
-    if (n_leading_zeroes == 0) {
-        new_str = bnu_strndup(str, len);
-    } else {
-        new_str = BN_MALLOC((new_len + 1) * sizeof(char));
-        memset(new_str, 0, new_len + 1);
-        memset(new_str, '0', n_leading_zeroes);
+    size_t count;
+    uint64_t* primes = bnl_primes(n, &count);
+    uint64_t* exps = BN_MALLOC(count * sizeof(uint64_t));
 
-        // copy all the "real" digits from the old string
-        memcpy(new_str + n_leading_zeroes, str, len);
+    // legendre: p appears n/p + n/p^2 + ... times in n!
+    for (size_t i = 0; i < count; i++) {
+        exps[i] = 0;
+        for (uint64_t m = n / primes[i]; m > 0; m /= primes[i]) {
+            exps[i] += m;
+        }
     }
 
-    // parse the number, mp characters at a time
+    bni_prime_power_product(out, primes, exps, count, base);
 
-    // guaranteed: new_len % mp == 0 -- very important
-    uint32_t num_digits = new_len / mp;
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(primes);
+        BN_FREE(exps);
+    }
+}
 
-    Bignum result = {
-        .base = base,
-        .digits_end = BN_MALLOC(num_digits * sizeof(uint32_t)),
-        .capacity = num_digits,
-        .signbit = (is_negative) ? 1 : 0,
-    };
-    memset(result.digits_end, 0, num_digits * sizeof(uint32_t));
+void bni_binom(Bignum* out, uint64_t n, uint64_t k, bn_base_t base) {
 
-    // loop in reverse order
-    uint32_t* dp = &result.digits_end[result.capacity - 1];
-    char* sp = new_str;
+    // binom(n, 0) = 1
+    if (k == 0) {
+        bni_write_parts1(out, 0, 1, base);
+        return;
+    }
 
-    while (sp < new_str + len) {
+    // small k => (n-k+1) * ... * n // k!, no sieve up to n needed
+    if (n > UINT32_MAX || k < n / 16) {
+        uint64_t* xs = BN_MALLOC(k * sizeof(uint64_t));
+        for (uint64_t i = 0; i < k; i++) {
+            xs[i] = n - k + 1 + i;
+        }
 
-        // mp characters => 1 digit
-        if (!bnu_parse_digit(sp, 0, mp, base, dp)) {
-            // nth digit conversion failed
-            bni_try_free(&result);
-            return false;
+        Bignum num = {0};
+        Bignum den = {0};
+        bni_product_u64(&num, xs, k, base);
+        bni_fact(&den, k, base);
+        bn_divmod(out, NULL, &num, &den);
+
+        if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+            BN_FREE(xs);
         }
+        bn_free(&num, &den);
+        return;
+    }
 
-        sp += mp;
-        dp -= 1;
+    size_t count;
+    uint64_t* primes = bnl_primes(n, &count);
+    uint64_t* exps = BN_MALLOC(count * sizeof(uint64_t));
+
+    // legendre for n! / (k! (n-k)!)
+    for (size_t i = 0; i < count; i++) {
+        uint64_t p = primes[i];
+        exps[i] = 0;
+        for (uint64_t a = n / p, b = k / p, c = (n - k) / p;
+             a > 0;
+             a /= p, b /= p, c /= p)
+        {
+            exps[i] += a - b - c;
+        }
     }
 
+    bni_prime_power_product(out, primes, exps, count, base);
+
     if (BN_CONFIG.no_free == BC_NF_DISABLED) {
-        BN_FREE(new_str);
+        BN_FREE(primes);
+        BN_FREE(exps);
     }
+}
 
-    bni_try_free(out);
-    *out = result;
-    bni_normalize(out);
-    return true;
+void bni_fib(Bignum* f_out, Bignum* f1_out, uint64_t n, bn_base_t base) {
+
+    // fast doubling, from (F(k), F(k-1)) with two squares per bit of n
+    //   F(2k-1) = F(k)^2 + F(k-1)^2
+    //   F(2k+1) = 4F(k)^2 - F(k-1)^2 + 2(-1)^k
+    //   F(2k)   = F(2k+1) - F(2k-1)
+
+    Bignum f = {0};     // F(k)
+    Bignum f1 = {0};    // F(k-1)
+    Bignum f_sqr = {0};
+    Bignum f1_sqr = {0};
+    Bignum t = {0};
+    Bignum two = {0};
+
+    bni_write_parts1(&f, 0, 1, base);
+    bni_write_parts1(&f1, 0, 0, base);
+    bni_write_parts1(&two, 0, 2, base);
+
+    // k = 1, the top bit of n
+    int bit = 63;
+    while (((n >> bit) & 1) == 0) {
+        bit--;
+    }
+    uint64_t k = 1;
+
+    while (bit-- > 0) {
+        bn_sqr(&f_sqr, &f);
+        bn_sqr(&f1_sqr, &f1);
+
+        // f1 = F(2k-1)
+        bn_add(&f1, &f_sqr, &f1_sqr);
+
+        // f = F(2k+1)
+        bn_add(&t, &f_sqr, &f_sqr);
+        bn_add(&t, &t, &t);
+        bn_sub(&t, &t, &f1_sqr);
+        if (k % 2 == 0) {
+            bn_add(&f, &t, &two);
+        } else {
+            bn_sub(&f, &t, &two);
+        }
+
+        // t = F(2k)
+        bn_sub(&t, &f, &f1);
+
+        if ((n >> bit) & 1) {
+            // (F(2k+1), F(2k))
+            Bignum temp = f1;
+            f1 = t;
+            t = temp;
+            k = 2 * k + 1;
+        } else {
+            // (F(2k), F(2k-1))
+            Bignum temp = f;
+            f = t;
+            t = temp;
+            k = 2 * k;
+        }
+    }
+
+    bn_free(&f_sqr, &f1_sqr, &t, &two);
+
+    bni_try_free(f_out);
+    *f_out = f;
+    bni_try_free(f1_out);
+    *f1_out = f1;
 }
 
-bool bni_write_parts1(Bignum* out,
-                      uint8_t signbit,
-                      bn_digit_t d0,
-                      bn_base_t base)
+// binary splitting for chudnovsky's series
+//   1/pi = 12 / C^(3/2) * sum (-1)^k (6k)! (A + Bk) / ((3k)! k!^3 C^3k)
+// over the terms [a, b), as P = product of the term ratio numerators,
+// Q = product of the denominators and T = the partial sum scaled by Q.
+// P is only needed by the next range over, so it's skipped along the right
+// edge of the tree (need_p = false)
+typedef struct {
+    Bignum p;
+    Bignum q;
+    Bignum t;
+} BignumSplit;
+
+#define BN_CHUDNOVSKY_A      13591409
+#define BN_CHUDNOVSKY_B      545140134
+#define BN_CHUDNOVSKY_C3_24  10939058860032000ULL  // 640320^3 / 24
+
+static void bni_chudnovsky_split(BignumSplit* out, uint64_t a, uint64_t b,
+                                 bool need_p,
+                                 bn_base_t base)
 {
-    if (!bnu_digit_in_range(d0, base)) {
-        return false;
+    *out = (BignumSplit){0};
+
+    if (b - a == 1) {
+        if (a == 0) {
+            bni_write_parts1(&out->p, 0, 1, base);
+            bni_write_parts1(&out->q, 0, 1, base);
+        } else {
+            // p = -(6a - 5)(2a - 1)(6a - 1)
+            Bignum t = {0};
+            bni_write_u64(&out->p, 0, 6 * a - 5, base);
+            bni_write_u64(&t, 0, 2 * a - 1, base);
+            bni_mul(&out->p, &out->p, &t);
+            bni_write_u64(&t, 0, 6 * a - 1, base);
+            bni_mul(&out->p, &out->p, &t);
+            out->p.signbit = 1;
+
+            // q = a^3 * C^3 / 24
+            bni_write_u64(&out->q, 0, a, base);
+            bni_pow(&out->q, &out->q, 3);
+            bni_write_u64(&t, 0, BN_CHUDNOVSKY_C3_24, base);
+            bni_mul(&out->q, &out->q, &t);
+            bni_try_free(&t);
+        }
+
+        // t = p * (A + B*a)
+        Bignum t = {0};
+        Bignum u = {0};
+        bni_write_u64(&t, 0, a, base);
+        bni_write_u64(&u, 0, BN_CHUDNOVSKY_B, base);
+        bni_mul(&t, &t, &u);
+        bni_write_u64(&u, 0, BN_CHUDNOVSKY_A, base);
+        bni_add(&t, &t, &u);
+        bn_mul(&out->t, &out->p, &t);
+        bn_free(&t, &u);
+        return;
     }
 
-    bni_freealloc(out, 1, base);
-    out->signbit = signbit;
-    out->digits_end[0] = d0;
-    bni_normalize(out);
-    return true;
+    uint64_t m = a + (b - a) / 2;
+    BignumSplit l, r;
+    bni_chudnovsky_split(&l, a, m, true, base);
+    bni_chudnovsky_split(&r, m, b, need_p, base);
+
+    // P = P1 P2, Q = Q1 Q2, T = T1 Q2 + P1 T2
+    Bignum t = {0};
+    if (need_p) {
+        bn_mul(&out->p, &l.p, &r.p);
+    }
+    bni_mul(&out->q, &l.q, &r.q);
+    bn_mul(&out->t, &l.t, &r.q);
+    bn_mul(&t, &l.p, &r.t);
+    bn_add(&out->t, &out->t, &t);
 
+    bn_free(&l.p, &l.q, &l.t, &r.p, &r.q, &r.t, &t);
 }
 
-bool bni_write_parts2(Bignum* out,
-                      uint8_t signbit,
-                      bn_digit_t d0, bn_digit_t d1,
-                      bn_base_t base)
+// binary splitting for e = sum 1/k!, over the terms (a, b] as
+// Q = (a+1)(a+2)...b and T = Q * sum a!/k!
+static void bni_e_split(BignumSplit* out, uint64_t a, uint64_t b,
+                        bn_base_t base)
 {
-    if (!bnu_digit_in_range(d0, base)
-    || !bnu_digit_in_range(d1, base)) {
-        return false;
+    *out = (BignumSplit){0};
+
+    if (b - a == 1) {
+        bni_write_u64(&out->q, 0, b, base);
+        bni_write_parts1(&out->t, 0, 1, base);
+        return;
     }
 
-    bni_freealloc(out, 2, base);
-    out->signbit = signbit;
-    out->digits_end[1] = d0;
-    out->digits_end[0] = d1;
-    bni_normalize(out);
-    return true;
+    uint64_t m = a + (b - a) / 2;
+    BignumSplit l, r;
+    bni_e_split(&l, a, m, base);
+    bni_e_split(&r, m, b, base);
 
+    // Q = Q1 Q2, T = T1 Q2 + T2
+    bni_mul(&out->q, &l.q, &r.q);
+    bni_mul(&out->t, &l.t, &r.q);
+    bni_add(&out->t, &out->t, &r.t);
+
+    bn_free(&l.q, &l.t, &r.q, &r.t);
 }
 
-size_t bni_print(const Bignum* b, bool explicit_base, bool use_uppercase) {
-    if (b->digits_end == NULL || b->capacity == 0) {
-        fputs("(null)", stdout);
-        return 6;
-    }
+// guard digits for pi and e, dropped at the end
+#define BN_CONSTANT_GUARD_DIGITS 2
 
-    if (bn_equals_zero(b)) {
-        fputs("0", stdout);
-        return 1;
+void bni_pi(Bignum* out, uint64_t digits, bn_base_t base) {
+
+    // work with scale = base^(digits + guard)
+    uint64_t width = BN_BASE[base].width;
+    uint64_t k = digits + BN_CONSTANT_GUARD_DIGITS * width;
+
+    // each term is worth log(C^3 / 24 * 72) = log(151931373056000) more
+    uint64_t n_terms = (uint64_t)(k * log(base) / log(151931373056000.0)) + 2;
+
+    BignumSplit s;
+    bni_chudnovsky_split(&s, 0, n_terms, false, base);
+
+    // pi * scale = 426880 * sqrt(10005 * scale^2) * Q / T
+    Bignum x = {0};
+    Bignum t = {0};
+    bni_write_base_power(&x, 2 * k, base);
+    bni_write_u64(&t, 0, 10005, base);
+    bni_mul(&x, &x, &t);
+    bni_iroot(&x, &x, 2);
+
+    bni_write_u64(&t, 0, 426880, base);
+    bni_mul(&x, &x, &t);
+    bni_mul(&x, &x, &s.q);
+    bn_divmod(&x, NULL, &x, &s.t);
+
+    bni_rshift(out, &x, BN_CONSTANT_GUARD_DIGITS);
+    bn_free(&s.p, &s.q, &s.t, &x, &t);
+}
+
+void bni_e(Bignum* out, uint64_t digits, bn_base_t base) {
+
+    // work with scale = base^(digits + guard)
+    uint64_t width = BN_BASE[base].width;
+    uint64_t k = digits + BN_CONSTANT_GUARD_DIGITS * width;
+
+    // enough terms that n! > scale
+    double target = k * log(base);
+    double log_fact = 0;
+    uint64_t n_terms = 1;
+    while (log_fact <= target + 1) {
+        n_terms += 1;
+        log_fact += log(n_terms);
     }
 
-    // number of characters printed
-    size_t nc = 0;
+    BignumSplit s;
+    bni_e_split(&s, 0, n_terms, base);
 
-    if (b->signbit) {
-        fputs("-", stdout);
-        nc += 1;
+    // e * scale = scale + T * scale / Q
+    Bignum scale = {0};
+    Bignum x = {0};
+    bni_write_base_power(&scale, k, base);
+    bni_mul(&x, &s.t, &scale);
+    bn_divmod(&x, NULL, &x, &s.q);
+    bni_add(&x, &x, &scale);
+
+    bni_rshift(out, &x, BN_CONSTANT_GUARD_DIGITS);
+    bn_free(&s.q, &s.t, &scale, &x);
+}
+
+void bni_divqr_Nx1(Bignum* q_out, Bignum* r_out,
+                const Bignum* a0,
+                bn_digit_t a1)
+{
+    size_t n = bni_real_len(a0);
+
+    Bignum q_result = {0};
+    if (q_out != NULL) {
+        bni_freealloc(&q_result, n, a0->base);
     }
 
-    // print leading digit without leading 0s
-    nc += bnu_print_digit(b->digits_end[b->msd_pos], b->base,
-        false, use_uppercase);
+    bn_digit_t r = bnl_divrem_1(q_out != NULL ? q_result.digits_end : NULL,
+                                a0->digits_end, n,
+                                a1,
+                                BN_BASE[a0->base].real_base);
+
+    // return result
+    if (q_out != NULL) {
+        bni_try_free(q_out);
+        *q_out = q_result;
+        bni_normalize(q_out);
+    }
+    if (r_out != NULL) {
+        // remainder is always 1 digit
+        bni_freealloc(r_out, 1, a0->base);
+        r_out->digits_end[0] = r;
+    }
+}
 
-    // does it only have 1 digit?
-    if (b->msd_pos == 0) {
-        if (explicit_base) {
-            nc += printf("_%u", b->base);
+void bni_divqr_NxM(Bignum* q_out, Bignum* r_out,
+                const Bignum* a0,
+                const Bignum* a1)
+{
+    size_t m = bni_real_len(a0);
+    size_t n = bni_real_len(a1);
+    uint64_t real_base = BN_BASE[a0->base].real_base;
+
+    // a0 shorter than a1 => [0, a0]
+    if (m < n) {
+        if (q_out != NULL) {
+            bni_write_parts1(q_out, 0, 0, a0->base);
+        }
+        if (r_out != NULL) {
+            bni_copy(r_out, a0);
         }
-        return nc;
+        return;
     }
 
-    // print remaining digits with leading 0s
-    for (size_t i = b->msd_pos-1; &b->digits_end[i] >= b->digits_end; i--) {
-        nc += bnu_print_digit(b->digits_end[i], b->base,
-            true, use_uppercase);
+    // long divisor and long quotient => newton's method
+    if (n >= BN_DIV_NEWTON_THRESHOLD && m - n >= BN_DIV_NEWTON_THRESHOLD) {
+        bni_divqr_newton(q_out, r_out, a0, a1);
+        return;
     }
 
-    if (explicit_base) {
-        nc += printf("_%u", b->base);
+    bn_digit_t* scratch = BN_MALLOC(bnl_divrem_scratch_len(m, n)
+                                    * sizeof(bn_digit_t));
+
+    Bignum q_result = {0};
+    if (q_out != NULL) {
+        bni_freealloc(&q_result, m - n + 1, a0->base);
+    }
+    Bignum r_result = {0};
+    if (r_out != NULL) {
+        bni_freealloc(&r_result, n, a0->base);
     }
 
-    return nc;
+    bnl_divrem(q_out != NULL ? q_result.digits_end : NULL,
+               r_out != NULL ? r_result.digits_end : NULL,
+               a0->digits_end, m,
+               a1->digits_end, n,
+               real_base, scratch);
+
+    if (r_out != NULL) {
+        bni_try_free(r_out);
+        *r_out = r_result;
+        bni_normalize(r_out);
+    }
+
+    if (q_out != NULL) {
+        bni_try_free(q_out);
+        *q_out = q_result;
+        bni_normalize(q_out);
+    }
+
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(scratch);
+    }
 }
 
-void bni_dump(const Bignum* b) {
-    if (b->digits_end == NULL) {
-        printf("Bignum{\n"
-            "  .base=%lu,\n"
-            "  .signbit=%lu,\n"
-            "  .capacity=%llu,\n"
-            "  rlen=%lu,\n"
-            "  .digits=[]}\n",
-        (unsigned long)b->base,
-        (unsigned long)b->signbit,
-        (unsigned long long)b->capacity,
-        (unsigned long)bni_real_len(b));
-    } else {
+void bni_recip(Bignum* out, const Bignum* a0) {
 
-        printf("Bignum{\n"
-            "  .base=%lu,\n"
-            "  .signbit=%lu,\n"
-            "  .capacity=%llu,\n"
-            "  rlen=%lu,\n"
-            "  .digits=[\n"
-            "    <mem_start>\n",
-        (unsigned long)b->base,
-        (unsigned long)b->signbit,
-        (unsigned long long)b->capacity,
-        (unsigned long)bni_real_len(b));
+    size_t n = bni_real_len(a0);
+    bn_base_t base = a0->base;
+    uint64_t width = BN_BASE[base].width;
 
-        for (uint64_t i = 0; i < b->capacity; i++) {
-            printf(
-            "    %0*lu,%s\n",
-            BN_BASE[b->base].width,
-            (unsigned long) b->digits_end[i],
-            i == b->msd_pos ? " <-- MSD" : "");
+    Bignum b_2n = {0};
+    bni_write_base_power(&b_2n, 2 * n * width, base);
+
+    // small enough for long division
+    if (n < BN_DIV_NEWTON_THRESHOLD) {
+        if (n == 1) {
+            bni_divqr_Nx1(out, NULL, &b_2n, a0->digits_end[0]);
+        } else {
+            bni_divqr_NxM(out, NULL, &b_2n, a0);
         }
+        bni_try_free(&b_2n);
+        return;
+    }
 
-        printf(
-            "    <mem_end>\n"
-            "  ]}\n");
+    // x = reciprocal of the top h digits, x * real_base^s is good to about h
+    // digits and one newton step doubles that
+    size_t h = n / 2 + 3;
+    size_t s = n - h;
+
+    Bignum x = {0};
+    Bignum e = {0};
+    Bignum t = {0};
+    bni_rshift(&t, a0, s);
+    bni_recip(&x, &t);
+
+    // e = real_base^2n - a0 * x, the error of x scaled by a0
+    bni_mul(&t, a0, &x);
+    bni_lshift(&t, &t, s);
+    bn_sub(&e, &b_2n, &t);
+
+    // x += x * e / real_base^2n, only the top digits of e matter here
+    uint8_t e_signbit = e.signbit;
+    e.signbit = 0;
+    bni_rshift(&e, &e, n - 2);
+    if (!bn_equals_zero(&e)) {
+        bni_mul(&t, &x, &e);
+        bni_rshift(&t, &t, h + 2);
+        t.signbit = e_signbit && !bn_equals_zero(&t);
+        bni_lshift(&x, &x, s);
+        bn_add(&x, &x, &t);
+    } else {
+        bni_lshift(&x, &x, s);
     }
-}
 
-int bni_cmp_Nx1(const Bignum* a0, bn_digit_t a1) {
-    if (bni_real_len(a0) > 1) return 1;
-    if (a0->digits_end[0] > a1) return 1;
-    if (a0->digits_end[0] < a1) return -1;
-    return 0;
+    // x is within a few units now, walk it to the exact value
+    Bignum one = {0};
+    bni_write_parts1(&one, 0, 1, base);
+    bni_mul(&t, a0, &x);
+    bn_sub(&e, &b_2n, &t);
+    while (e.signbit && !bn_equals_zero(&e)) {
+        bn_sub(&x, &x, &one);
+        bn_add(&e, &e, a0);
+    }
+    while (bni_cmp_NxM(&e, a0) >= 0) {
+        bn_add(&x, &x, &one);
+        bni_sub(&e, &e, a0);
+    }
+
+    bn_free(&b_2n, &e, &t, &one);
+    bni_try_free(out);
+    *out = x;
 }
 
-int bni_cmp_NxM(const Bignum* a0, const Bignum* a1) {
-    if (a0->signbit && !a1->signbit) {
-        return -1; // a0 < 0 < a1
-    } else if (!a0->signbit && a1->signbit) {
-        return 1; // a1 < 0 < a0
-    }
+void bni_divqr_newton(Bignum* q_out, Bignum* r_out,
+                      const Bignum* a0,
+                      const Bignum* a1)
+{
+    size_t m = bni_real_len(a0);
+    size_t n = bni_real_len(a1);
+    size_t k = m - n;
+    bn_base_t base = a0->base;
+
+    Bignum q = {0};
+    Bignum r = {0};
+
+    if (n > k + 2) {
+        // quotient much shorter than the divisor - the top 2k+2 digits over
+        // the top k+2 digits is within a couple of units of it
+        size_t s = n - (k + 2);
+        Bignum u = {0};
+        Bignum v = {0};
+        bni_rshift(&u, a0, s);
+        bni_rshift(&v, a1, s);
+        bn_divmod(&q, NULL, &u, &v);
+
+        // r = a0 - q * a1, then fix q up until 0 <= r < a1
+        Bignum one = {0};
+        bni_write_parts1(&one, 0, 1, base);
+        bn_mul(&r, &q, a1);
+        bn_sub(&r, a0, &r);
+        while (r.signbit && !bn_equals_zero(&r)) {
+            bn_sub(&q, &q, &one);
+            bn_add(&r, &r, a1);
+        }
+        while (bni_cmp_NxM(&r, a1) >= 0) {
+            bn_add(&q, &q, &one);
+            bni_sub(&r, &r, a1);
+        }
 
-    // a0, a1 have same sign
-    int sign = a0->signbit ? -1 : 1;
+        bn_free(&u, &v, &one);
+    } else {
+        // barrett reduction with mu = the reciprocal of a1, n quotient digits
+        // per step like one very wide digit of long division
+        BignumBarrett br = { .m = *a1, .n = n };
+        bni_recip(&br.mu, a1);
+
+        // the first step takes the top 2n digits (or less), c more steps
+        // bring down n digits each
+        size_t c = (m > 2 * n) ? (m - n - 1) / n : 0;
+
+        bni_freealloc(&q, (c + 1) * n + 1, base);
+        memset(q.digits_end, 0, q.capacity * sizeof(bn_digit_t));
+
+        Bignum t = {0};
+        Bignum qj = {0};
+        if (c == 0) {
+            bni_copy(&t, a0);
+        } else {
+            bni_rshift(&t, a0, c * n);
+        }
 
-    // compare real lengths, accounting for where start is not just capacity
-    size_t len0 = bni_real_len(a0);
-    size_t len1 = bni_real_len(a1);
-    if (len0 > len1) {
-        return sign * 1;
-    } else if (len0 < len1) {
-        return sign * -1;
-    }
+        for (size_t j = c + 1; j-- > 0;) {
+
+            // t = r * real_base^n + the next n digits of a0
+            if (j != c) {
+                size_t len_r = bni_real_len(&r);
+                bni_freealloc(&t, n + len_r, base);
+                memcpy(t.digits_end, a0->digits_end + j * n,
+                       n * sizeof(bn_digit_t));
+                memcpy(t.digits_end + n, r.digits_end,
+                       len_r * sizeof(bn_digit_t));
+                bni_normalize(&t);
+            }
 
-    // compare digitwise MSD -> LSD
-    for (size_t i = a0->msd_pos; &a0->digits_end[i] >= a0->digits_end; i--) {
-        if (a0->digits_end[i] > a1->digits_end[i]) {
-            return sign * 1;
-        } else if (a0->digits_end[i] < a1->digits_end[i]) {
-            return sign * -1;
+            bni_barrett_divqr(&qj, &r, &br, &t);
+            memcpy(q.digits_end + j * n, qj.digits_end,
+                   bni_real_len(&qj) * sizeof(bn_digit_t));
         }
+
+        bni_normalize(&q);
+        bn_free(&br.mu, &t, &qj);
     }
 
-    // all digits are equal
-    return 0;
-}
+    if (q_out != NULL) {
+        bni_try_free(q_out);
+        *q_out = q;
+    } else {
+        bni_try_free(&q);
+    }
 
-void bni_lshift(Bignum* out, const Bignum* a0, size_t n) {
-    if (bn_equals_zero(a0)) {
-        bni_copy(out, a0);
-        return;
+    if (r_out != NULL) {
+        bni_try_free(r_out);
+        *r_out = r;
+    } else {
+        bni_try_free(&r);
     }
+}
 
-    size_t rlen0 = bni_real_len(a0);
-    size_t new_len = rlen0 + n;
+// t = t / R % m, montgomery reduction
+// assumes t has 2n + 1 digits and t < m * R, the result is left in t[n..2n]
+static void bnl_mont_redc(bn_digit_t* t, const BignumMont* mont) {
 
-    Bignum result = {0};
-    bni_freealloc(&result, new_len, a0->base);
+    size_t n = mont->n;
+    const bn_digit_t* m = mont->m.digits_end;
+    uint64_t real_base = BN_BASE[mont->m.base].real_base;
 
-    bn_digit_t* dest = result.digits_end + n;
-    bn_digit_t* src = a0->digits_end;
+    for (size_t i = 0; i < n; i++) {
 
-    for (size_t i = 0; i < rlen0; i++) {
-        dest[i] = src[i];
+        // choose u so that the i-th digit of t + u*m*B^i is zero
+        uint64_t u = (uint64_t)t[i] * mont->m_inv % real_base;
+
+        uint64_t carry = 0;
+        for (size_t j = 0; j < n; j++) {
+            uint64_t p = u * m[j] + t[i + j] + carry;
+            t[i + j] = p % real_base;
+            carry = p / real_base;
+        }
+        for (size_t k = i + n; carry != 0 && k <= 2 * n; k++) {
+            uint64_t sum = t[k] + carry;
+            t[k] = sum % real_base;
+            carry = sum / real_base;
+        }
     }
 
-    for (size_t i = 0; i < n; i++) {
-        result.digits_end[i] = 0;
+    // t[n..2n] < 2m, subtract once if needed
+    bn_digit_t* r = t + n;
+    bool ge = (r[n] != 0);
+    if (!ge) {
+        ge = true;
+        for (size_t i = n; i-- > 0;) {
+            if (r[i] != m[i]) {
+                ge = (r[i] > m[i]);
+                break;
+            }
+        }
+    }
+    if (ge) {
+        bnl_sub(r, r, n + 1, m, n, real_base);
     }
+}
 
-    result.msd_pos = new_len - 1;
-    result.signbit = a0->signbit;
+// r = a * b / R % m
+// r, a, b have n digits, t has 2n + 1, scratch has bnl_mul_scratch_len(n)
+static void bnl_mont_mul(bn_digit_t* r,
+                         const bn_digit_t* a, const bn_digit_t* b,
+                         const BignumMont* mont,
+                         bn_digit_t* t, bn_digit_t* scratch)
+{
+    size_t n = mont->n;
+    bn_digit_t real_base = BN_BASE[mont->m.base].real_base;
 
-    bni_try_free(out);
-    *out = result;
-    bni_normalize(out);
+    if (a == b) {
+        bnl_sqr(t, a, n, real_base, scratch);
+    } else {
+        bnl_mul(t, a, n, b, n, real_base, scratch);
+    }
+    t[2 * n] = 0;
+
+    bnl_mont_redc(t, mont);
+    memcpy(r, t + n, n * sizeof(bn_digit_t));
 }
 
-void bni_rshift(Bignum* out, const Bignum* a0, size_t n) {
-    if (bn_equals_zero(a0)) {
-        bni_copy(out, a0);
-        return;
-    }
+void bni_barrett_reduce(Bignum* out,
+                        const BignumBarrett* br,
+                        const Bignum* a0)
+{
+    bni_barrett_divqr(NULL, out, br, a0);
+}
 
-    size_t rlen0 = bni_real_len(a0);
+void bni_barrett_divqr(Bignum* q_out, Bignum* r_out,
+                       const BignumBarrett* br,
+                       const Bignum* a0)
+{
+    size_t n = br->n;
 
-    if (n >= rlen0) {
-        bni_write_parts1(out, 0, 0, BN_BASE_DEFAULT);
+    // a0 < real_base^(n-1) <= m => [0, a0]
+    if (bni_real_len(a0) < n) {
+        if (q_out != NULL) {
+            bni_write_parts1(q_out, 0, 0, a0->base);
+        }
+        if (r_out != NULL) {
+            bni_copy(r_out, a0);
+        }
         return;
     }
 
-    size_t new_len = rlen0 - n;
-
-    Bignum result = {0};
-    bni_freealloc(&result, new_len, a0->base);
+    // q = ((a0 >> (n-1)) * mu) >> (n+1) is at most 2 below a0 // m
+    Bignum q = {0};
+    bni_rshift(&q, a0, n - 1);
+    if (!bn_equals_zero(&q)) {
+        bni_mul(&q, &q, &br->mu);
+    }
+    bni_rshift(&q, &q, n + 1);
 
-    bn_digit_t* dest = result.digits_end;
-    bn_digit_t* src = a0->digits_end + n;
+    Bignum r = {0};
+    Bignum t = {0};
+    if (bn_equals_zero(&q)) {
+        bni_copy(&r, a0);
+    } else {
+        bni_mul(&t, &q, &br->m);
+        bni_sub(&r, a0, &t);
+    }
 
-    for (size_t i = 0; i < new_len; i++) {
-        dest[i] = src[i];
+    bn_digit_t fixup = 0;
+    while (bni_cmp_NxM(&r, &br->m) >= 0) {
+        bni_sub(&r, &r, &br->m);
+        fixup += 1;
     }
 
-    result.msd_pos = new_len - 1;
-    result.signbit = a0->signbit;
+    if (q_out != NULL) {
+        if (fixup != 0) {
+            bni_write_parts1(&t, 0, fixup, q.base);
+            bni_add(&q, &q, &t);
+        }
+        bni_try_free(q_out);
+        *q_out = q;
+    } else {
+        bni_try_free(&q);
+    }
 
-    bni_try_free(out);
-    *out = result;
-    bni_normalize(out);
+    bni_try_free(&t);
+    if (r_out != NULL) {
+        bni_try_free(r_out);
+        *r_out = r;
+    } else {
+        bni_try_free(&r);
+    }
 }
 
-void bni_neg(Bignum* out, const Bignum* a0) {
+void bni_mont_powmod(Bignum* out, const BignumMont* mont,
+                     const Bignum* a0,
+                     const Bignum* e)
+{
+    // sliding window exponentiation in montgomery form
 
-    Bignum result = {0};
-    bni_copy(&result, a0);
-    result.signbit = !result.signbit;
+    size_t n = mont->n;
 
-    *out = result;
-    bni_normalize(out);
-}
+    // exponent bits come from its base 2 digits, 31 bits each
+    Bignum exp = {0};
+    bn_convert(&exp, e, 2);
+    uint8_t bits_per_digit = BN_BASE[2].width;
 
-void bni_add(Bignum* out, const Bignum* a0, const Bignum* a1) {
-    // carry algorithm
+    size_t n_bits = bni_real_len(&exp) * bits_per_digit;
+    #define EXP_BIT(i) \
+        ((exp.digits_end[(i) / bits_per_digit] >> ((i) % bits_per_digit)) & 1)
+    while (n_bits > 1 && !EXP_BIT(n_bits - 1)) {
+        n_bits--;
+    }
 
-    // swap the numbers such that a0->len >= a1->len
-    // this makes computation simpler in the loop
-    // also guarantees `max(len0, len1) == len0`
-    if (bni_real_len(a0) < bni_real_len(a1)) {
-        const Bignum* temp = a0;
-        a0 = a1;
-        a1 = temp;
+    size_t w = (n_bits > 671) ? 6
+        : (n_bits > 239) ? 5
+        : (n_bits > 79) ? 4
+        : (n_bits > 23) ? 3
+        : (n_bits > 7) ? 2
+        : 1;
+    size_t n_odd = (size_t)1 << (w - 1);
+
+    // workspace: product (2n + 1), mul scratch, accumulator, a^2 and the
+    // odd powers a^1, a^3, ... a^(2^w - 1)
+    size_t scratch_len = bnl_mul_scratch_len(n) + bnl_sqr_scratch_len(n);
+    bn_digit_t* ws = BN_MALLOC(
+        ((2 * n + 1) + scratch_len + (2 + n_odd) * n) * sizeof(bn_digit_t));
+    bn_digit_t* t = ws;
+    bn_digit_t* scratch = t + (2 * n + 1);
+    bn_digit_t* acc = scratch + scratch_len;
+    bn_digit_t* a_sqr = acc + n;
+    bn_digit_t* odd = a_sqr + n;
+
+    // odd[0] = a0 * R % m
+    memset(acc, 0, n * sizeof(bn_digit_t));
+    memcpy(acc, a0->digits_end, bni_real_len(a0) * sizeof(bn_digit_t));
+    bn_digit_t* r2 = a_sqr;
+    memset(r2, 0, n * sizeof(bn_digit_t));
+    memcpy(r2, mont->r2.digits_end,
+           bni_real_len(&mont->r2) * sizeof(bn_digit_t));
+    bnl_mont_mul(odd, acc, r2, mont, t, scratch);
+
+    bnl_mont_mul(a_sqr, odd, odd, mont, t, scratch);
+    for (size_t i = 1; i < n_odd; i++) {
+        bnl_mont_mul(odd + i * n, odd + (i - 1) * n, a_sqr, mont, t, scratch);
     }
 
-    Bignum result = {0};
-    size_t max_len = 1 + bni_real_len(a0); // +1 for possible carry
-    bni_freealloc(&result, max_len, a0->base);
+    // the top bit is always 1 and always starts a window
+    bool acc_is_one = true;
 
-    bn_digit_t real_base = BN_BASE[result.base].real_base;
+    for (size_t i = n_bits; i-- > 0;) {
+        if (!EXP_BIT(i)) {
+            bnl_mont_mul(acc, acc, acc, mont, t, scratch);
+            continue;
+        }
 
-    // LSD -> MSD
-    bn_digit_t* d0 = a0->digits_end;
-    bn_digit_t* d1 = a1->digits_end;
-    bn_digit_t carry = 0;
+        // longest window ending in a 1 bit: bits i..l
+        size_t l = (i + 1 >= w) ? i + 1 - w : 0;
+        while (!EXP_BIT(l)) {
+            l++;
+        }
 
-    int i = 0;
-    while (d0 <= &a0->digits_end[a0->msd_pos]) {
-        bn_digit_t digit0 = *d0;
-        bn_digit_t digit1 = (d1 <= &a1->digits_end[a1->msd_pos]) ? *d1 : 0;
-        bn_digit_t sum = digit0 + digit1 + carry;
+        size_t value = 0;
+        for (size_t j = i + 1; j-- > l;) {
+            value = (value << 1) | EXP_BIT(j);
+        }
 
-        carry = sum / real_base;
-        result.digits_end[i] = sum % real_base;
+        if (acc_is_one) {
+            memcpy(acc, odd + (value / 2) * n, n * sizeof(bn_digit_t));
+            acc_is_one = false;
+        } else {
+            for (size_t j = l; j <= i; j++) {
+                bnl_mont_mul(acc, acc, acc, mont, t, scratch);
+            }
+            bnl_mont_mul(acc, acc, odd + (value / 2) * n, mont, t, scratch);
+        }
 
-        d0 += 1;
-        d1 += 1;
-        i += 1;
+        i = l;
     }
+    #undef EXP_BIT
 
-    result.signbit = 0;
-    result.msd_pos = i - 1;
+    // leave montgomery form: acc * 1 / R
+    memset(t, 0, (2 * n + 1) * sizeof(bn_digit_t));
+    memcpy(t, acc, n * sizeof(bn_digit_t));
+    bnl_mont_redc(t, mont);
+
+    Bignum result = {0};
+    bni_freealloc(&result, n, mont->m.base);
+    memcpy(result.digits_end, t + n, n * sizeof(bn_digit_t));
 
-    if (carry != 0) {
-        result.msd_pos += 1;
-        result.digits_end[i] = carry;
+    if (BN_CONFIG.no_free == BC_NF_DISABLED) {
+        BN_FREE(ws);
     }
+    bni_try_free(&exp);
 
     bni_try_free(out);
     *out = result;
     bni_normalize(out);
 }
 
-void bni_sub(Bignum* out, const Bignum* a0, const Bignum* a1) {
-    // borrow algorithm
+// gcd
+//
+// every step below maps (a, b) to M*(a, b) for an integer matrix M with
+// determinant +-1, so gcd(a, b) never changes no matter how M was found.
+// lehmer picks M from the leading digits, half-gcd picks it recursively from
+// the top half of a and b. both only affect speed, never the result
+
+// 2x2 matrix of signed bignums
+typedef struct {
+    Bignum m[2][2];
+} BignumMatrix;
+
+static void bnm_init_identity(BignumMatrix* M, bn_base_t base) {
+    *M = (BignumMatrix){0};
+    bni_write_parts1(&M->m[0][0], 0, 1, base);
+    bni_write_parts1(&M->m[0][1], 0, 0, base);
+    bni_write_parts1(&M->m[1][0], 0, 0, base);
+    bni_write_parts1(&M->m[1][1], 0, 1, base);
+}
 
-    // a0 < a1 => -(a1 - a0)
-    if (bn_cmp(a0, a1) == -1) {
-        bni_sub(out, a1, a0);
-        out->signbit = !out->signbit;
-        return;
-    }
+static void bnm_free(BignumMatrix* M) {
+    bn_free(&M->m[0][0], &M->m[0][1], &M->m[1][0], &M->m[1][1]);
+}
 
-    // now assume a0 > a1
+// (x, y) = S*(x, y) for a matrix of small signed words
+static void bnm_lincomb_small(Bignum* x, Bignum* y, int64_t S[2][2]) {
 
-    Bignum result = {0};
-    bni_freealloc(&result, a0->capacity, a0->base);
+    Bignum s = {0};
+    Bignum t0 = {0}, t1 = {0};
+    Bignum new_x = {0}, new_y = {0};
+    bn_base_t base = x->base;
 
-    bn_digit_t real_base = BN_BASE[result.base].real_base;
+    for (int row = 0; row < 2; row++) {
+        int64_t c0 = S[row][0];
+        int64_t c1 = S[row][1];
 
-    // LSD -> MSD
-    bn_digit_t* d0 = a0->digits_end;
-    bn_digit_t* d1 = a1->digits_end;
-    uint8_t borrow = 0;
-    size_t i = 0;
-    while (d0 <= &a0->digits_end[a0->msd_pos] && i < result.capacity) {
+        bni_write_u64(&s, c0 < 0, c0 < 0 ? -c0 : c0, base);
+        bn_mul(&t0, &s, x);
+        bni_write_u64(&s, c1 < 0, c1 < 0 ? -c1 : c1, base);
+        bn_mul(&t1, &s, y);
+        bn_add(row == 0 ? &new_x : &new_y, &t0, &t1);
+    }
 
-        bn_digit_t digit0 = *d0;
-        bn_digit_t digit1 = (d1 <= &a1->digits_end[a1->msd_pos]) ? *d1 : 0;
+    bn_free(x, y, &s, &t0, &t1);
+    *x = new_x;
+    *y = new_y;
+}
 
-        int64_t diff = digit0;
+// (x, y) = (y, x - q*y)
+static void bnm_lincomb_quotient(Bignum* x, Bignum* y, const Bignum* q) {
+    Bignum t = {0};
+    bn_mul(&t, q, y);
+    bn_sub(&t, x, &t);
+    bn_free(x);
+    *x = *y;
+    *y = t;
+}
 
-        if (diff < borrow) {
-            diff += real_base;
-            diff -= borrow;
-            borrow = 1;
-        } else {
-            diff -= borrow;
-            borrow = 0;
-        }
+// (x, y) = N*(x, y)
+static void bnm_lincomb(Bignum* x, Bignum* y, const BignumMatrix* N) {
+    Bignum t0 = {0}, t1 = {0};
+    Bignum new_x = {0}, new_y = {0};
+
+    bn_mul(&t0, &N->m[0][0], x);
+    bn_mul(&t1, &N->m[0][1], y);
+    bn_add(&new_x, &t0, &t1);
+    bn_mul(&t0, &N->m[1][0], x);
+    bn_mul(&t1, &N->m[1][1], y);
+    bn_add(&new_y, &t0, &t1);
+
+    bn_free(x, y, &t0, &t1);
+    *x = new_x;
+    *y = new_y;
+}
 
-        if (diff < digit1) {
-            diff += real_base;
-            diff -= digit1;
-            borrow = 1;
-        } else {
-            diff -= digit1;
+// M = N*M
+static void bnm_mul(BignumMatrix* M, const BignumMatrix* N) {
+    for (int col = 0; col < 2; col++) {
+        bnm_lincomb(&M->m[0][col], &M->m[1][col], N);
+    }
+}
+
+// out = a0 % B^p
+static void bnm_low_digits(Bignum* out, const Bignum* a0, size_t p) {
+    size_t len = bnu_min(p, bni_real_len(a0));
+    bni_freealloc(out, len, a0->base);
+    memcpy(out->digits_end, a0->digits_end, len * sizeof(bn_digit_t));
+    bni_normalize(out);
+}
+
+// (a, b) = N*(a, b) where N*(a >> p, b >> p) is already known to be
+// (a_top, b_top) - only the low p digits need the multiplication. then make
+// both nonnegative and a >= b again, folding the sign flips and the swap
+// into N
+static void bnm_apply(BignumMatrix* N, Bignum* a, Bignum* b,
+                      const Bignum* a_top, const Bignum* b_top, size_t p)
+{
+    Bignum a_lo = {0}, b_lo = {0};
+    Bignum t = {0};
+
+    bnm_low_digits(&a_lo, a, p);
+    bnm_low_digits(&b_lo, b, p);
+    bnm_lincomb(&a_lo, &b_lo, N);
+
+    bni_lshift(&t, a_top, p);
+    bn_add(&a_lo, &a_lo, &t);
+    bni_lshift(&t, b_top, p);
+    bn_add(&b_lo, &b_lo, &t);
+
+    bn_free(a, b, &t);
+    *a = a_lo;
+    *b = b_lo;
+
+    if (a->signbit) {
+        a->signbit = 0;
+        bn_neg(&N->m[0][0], &N->m[0][0]);
+        bn_neg(&N->m[0][1], &N->m[0][1]);
+    }
+    if (b->signbit) {
+        b->signbit = 0;
+        bn_neg(&N->m[1][0], &N->m[1][0]);
+        bn_neg(&N->m[1][1], &N->m[1][1]);
+    }
+    if (bni_cmp_NxM(a, b) < 0) {
+        Bignum temp = *a;
+        *a = *b;
+        *b = temp;
+        for (int col = 0; col < 2; col++) {
+            temp = N->m[0][col];
+            N->m[0][col] = N->m[1][col];
+            N->m[1][col] = temp;
         }
+    }
+}
 
-        result.digits_end[i] = diff;
+// one lehmer step (knuth's algorithm L): find the matrix S of the quotients
+// that the leading digits of a and b agree on, then apply it to a and b in
+// place. entries of S stay below 2^30 so S*digit fits in an int64.
+// returns false without touching a, b if not even one quotient was certain
+static bool bni_lehmer_step(Bignum* a, Bignum* b, int64_t S[2][2]) {
 
-        d0 += 1;
-        d1 += 1;
-        i += 1;
+    size_t n = bni_real_len(a);
+    uint64_t real_base = BN_BASE[a->base].real_base;
+
+    // leading two digits of a, and the digits of b in the same places
+    int64_t x, y;
+    if (n == 1) {
+        x = a->digits_end[0];
+        y = b->digits_end[0];
+    } else {
+        uint64_t b1 = (bni_real_len(b) >= n) ? b->digits_end[n - 1] : 0;
+        uint64_t b0 = (bni_real_len(b) >= n - 1) ? b->digits_end[n - 2] : 0;
+        uint64_t ux = (uint64_t)a->digits_end[n - 1] * real_base
+            + a->digits_end[n - 2];
+        uint64_t uy = b1 * real_base + b0;
+
+        // keep both under 2^62
+        if (real_base > ((uint64_t)1 << 31)) {
+            ux >>= 2;
+            uy >>= 2;
+        }
+        x = ux;
+        y = uy;
     }
 
-    bni_try_free(out);
-    *out = result;
-    bni_normalize(out);
-}
+    const int64_t limit = (int64_t)1 << 29;
+    int64_t A = 1, B = 0, C = 0, D = 1;
 
-void bni_mul(Bignum* out, const Bignum* a0, const Bignum* a1) {
-    // naive algorithm - optimize later
+    while (y + C > 0 && y + D > 0) {
+        int64_t q = (x + A) / (y + C);
+        if (q != (x + B) / (y + D)) {
+            break;
+        }
+        if (q > limit / (llabs(C) + llabs(D) + 1)) {
+            break;
+        }
 
-    Bignum result = {0};
-    bni_freealloc(&result, bni_real_len(a0) + 1 + bni_real_len(a1) + 1,
-a0->base);
+        int64_t t;
+        t = A - q * C; A = C; C = t;
+        t = B - q * D; B = D; D = t;
+        t = x - q * y; x = y; y = t;
+    }
 
-    bn_digit_t real_base = BN_BASE[result.base].real_base;
-    bn_digit_t* r_ptr = result.digits_end;
+    if (B == 0) {
+        return false;
+    }
 
-    for (bn_digit_t* d0 = a0->digits_end; d0 <= &a0->digits_end[a0->msd_pos];
-d0++)
-    {
-        uint64_t carry = 0;
-        bn_digit_t* res_ptr = r_ptr;
+    S[0][0] = A; S[0][1] = B;
+    S[1][0] = C; S[1][1] = D;
 
-        for (bn_digit_t* d1 = a1->digits_end; d1 <=
-&a1->digits_end[a1->msd_pos]; d1++)
-        {
-            uint64_t product = (uint64_t)(*d0) * (*d1) + *res_ptr + carry;
-            *res_ptr = product % real_base;
-            carry = product / real_base;
-            res_ptr++;
+    // (a, b) = S*(a, b), both results are nonnegative and shorter than a
+    bni_unshare(a);
+    bni_unshare(b);
+    int64_t carry_a = 0, carry_b = 0;
+    size_t len_b = bni_real_len(b);
+    for (size_t i = 0; i < n; i++) {
+        int64_t da = a->digits_end[i];
+        int64_t db = (i < len_b) ? b->digits_end[i] : 0;
+
+        int64_t ta = A * da + B * db + carry_a;
+        int64_t tb = C * da + D * db + carry_b;
+
+        carry_a = ta / (int64_t)real_base;
+        ta %= (int64_t)real_base;
+        if (ta < 0) {
+            ta += real_base;
+            carry_a -= 1;
+        }
+        carry_b = tb / (int64_t)real_base;
+        tb %= (int64_t)real_base;
+        if (tb < 0) {
+            tb += real_base;
+            carry_b -= 1;
         }
 
-        if (carry > 0) {
-            *res_ptr += carry;
+        a->digits_end[i] = ta;
+        if (i < b->capacity) {
+            b->digits_end[i] = tb;
         }
-        r_ptr++;
     }
 
-    bni_try_free(out);
-    *out = result;
-    bni_normalize(out);
+    bni_normalize(a);
+    bni_normalize(b);
+    return true;
 }
 
-void bni_divqr_Nx1(Bignum* q_out, Bignum* r_out,
-                const Bignum* a0,
-                bn_digit_t a1)
-{
-    // naive algorithm - optimize later
+// one euclidean step (a, b) = (b, a % b), q_out = a // b
+static void bni_euclid_step(Bignum* a, Bignum* b, Bignum* q_out) {
+    Bignum r = {0};
+    bn_divmod(q_out, &r, a, b);
+    bni_try_free(a);
+    *a = *b;
+    *b = r;
+}
 
-    Bignum q_result = {0};
-    if (q_out != NULL) {
-        bni_freealloc(&q_result, bni_real_len(a0) + 1, a0->base);
+// lehmer or euclidean step on (a, b), and the same step on (x, y) and on
+// the rows of M if they're not NULL
+static void bni_gcd_step(Bignum* a, Bignum* b,
+                         Bignum* x, Bignum* y,
+                         BignumMatrix* M)
+{
+    int64_t S[2][2];
+    if (bni_lehmer_step(a, b, S)) {
+        if (x != NULL) {
+            bnm_lincomb_small(x, y, S);
+        }
+        if (M != NULL) {
+            bnm_lincomb_small(&M->m[0][0], &M->m[1][0], S);
+            bnm_lincomb_small(&M->m[0][1], &M->m[1][1], S);
+        }
+        return;
     }
 
-    // remainder is always 1 digit
-    Bignum r_result = {0};
-    if (r_out != NULL) {
-        bni_freealloc(&r_result, 1, a0->base);
-    }
-
-    if (bni_real_len(a0) == 1) {
-        // 1x1
-        bnu_divqr_1x1(a0->digits_end[0],
-                      a1,
-                      !!q_out ? &q_result.digits_end[0] : NULL,
-                      !!r_out ? &r_result.digits_end[0] : NULL);
-    } else if (bni_real_len(a0) == 2) {
-        // 2x1
-        bnu_divqr_2x1(a0->digits_end[1], a0->digits_end[0],
-                    a1,
-                    a0->base,
-                    !!q_out ? &q_result.digits_end[1] : NULL,
-                    !!q_out ? &q_result.digits_end[0] : NULL,
-                    !!r_out ? &r_result.digits_end[0] : NULL);
-    } else {
-        // 3x1 or more - do it in 2x1 steps
-
-        // prepend with a zero
-        Bignum arg0 = {0};
-        bni_copy(&arg0, a0);
-        bni_append_zeros(&arg0, 1);
-
-        // {d_0}{d_1}{d_2}...{d_n} /% D
-        // take 2 digits at a time:
+    Bignum q = {0};
+    bni_euclid_step(a, b, &q);
+    if (x != NULL) {
+        bnm_lincomb_quotient(x, y, &q);
+    }
+    if (M != NULL) {
+        bnm_lincomb_quotient(&M->m[0][0], &M->m[1][0], &q);
+        bnm_lincomb_quotient(&M->m[0][1], &M->m[1][1], &q);
+    }
+    bni_try_free(&q);
+}
 
-        // q_0 = {0}{d_0} // D
-        // r_0 = {0}{d_0} % D
-        // q_n = {r_n-1}{d_n} // D
-        // r_n = {r_n-1}{d_n} % D
+// half-gcd: run (a, b) in place about halfway down its remainder sequence,
+// until b has at most len(a)/2 + 1 digits, and return the matrix M of all the
+// steps taken. above BN_HGCD_THRESHOLD the first half of the way comes from a
+// recursive call on the top half of a and b, the second half from another
+// one on the top of what's left, so the work is a few multiplications by M
+// assumes a >= b >= 0
+static void bni_hgcd(BignumMatrix* M, Bignum* a, Bignum* b) {
+
+    size_t n = bni_real_len(a);
+    size_t target = n / 2 + 1;
+
+    bnm_init_identity(M, a->base);
+
+    if (n >= BN_HGCD_THRESHOLD) {
+        BignumMatrix N;
+        Bignum a_top = {0}, b_top = {0};
+
+        // a, b ~ n digits => ~3n/4
+        size_t p = n / 2;
+        bni_rshift(&a_top, a, p);
+        bni_rshift(&b_top, b, p);
+        if (!bn_equals_zero(&b_top)) {
+            bni_hgcd(&N, &a_top, &b_top);
+            bnm_apply(&N, a, b, &a_top, &b_top, p);
+            bnm_mul(M, &N);
+            bnm_free(&N);
+        }
 
-        // final result: {q_0}{q_1}{q_2}...{q_n} R {r_n}
+        // ~3n/4 => ~n/2
+        size_t k = bni_real_len(a);
+        if (!bn_equals_zero(b) && bni_real_len(b) > target && k < 2 * target) {
+            p = 2 * target - k;
+            bni_rshift(&a_top, a, p);
+            bni_rshift(&b_top, b, p);
+            if (!bn_equals_zero(&b_top)) {
+                bni_hgcd(&N, &a_top, &b_top);
+                bnm_apply(&N, a, b, &a_top, &b_top, p);
+                bnm_mul(M, &N);
+                bnm_free(&N);
+            }
+        }
 
-        // start of loop
-        int64_t i = a0->msd_pos;
+        bn_free(&a_top, &b_top);
+    }
 
-        // current quotient and remainder
-        bn_digit_t cq0, cq1, cr = 0;
+    // finish the rest (or all of it, below the threshold) step by step
+    while (!bn_equals_zero(b) && bni_real_len(b) > target) {
+        bni_gcd_step(a, b, NULL, NULL, M);
+    }
+}
 
-        // current two digits
-        Bignum ctd = {0};
-        bni_freealloc(&ctd, 2, arg0.base);
+void bni_gcd(Bignum* g_out, Bignum* s_out,
+             const Bignum* a0,
+             const Bignum* a1)
+{
+    // copied only once a lehmer step writes to them
+    Bignum a = {0};
+    Bignum b = {0};
+    bni_borrow(&a, a0);
+    bni_borrow(&b, a1);
+
+    // a == x*a1 (mod a0), b == y*a1 (mod a0)
+    Bignum x = {0};
+    Bignum y = {0};
+    if (s_out != NULL) {
+        bni_write_parts1(&x, 0, 0, a0->base);
+        bni_write_parts1(&y, 0, 1, a0->base);
+    }
 
-        while (i >= 0) {
+    while (!bn_equals_zero(&b)) {
 
-            // ctd = {r_n-1}{d_n}
-            // bni_write_parts2(&ctd, 0, cr, arg0.digits_end[i], arg0.base);
-            ctd.digits_end[1] = cr;
-            ctd.digits_end[0] = arg0.digits_end[i];
-            ctd.msd_pos = 1;
-
-            // get q_n and r_n
-            bnu_divqr_2x1(ctd.digits_end[1], ctd.digits_end[0],
-                            a1,
-                            arg0.base,
-                            &cq0, &cq1,
-                            &cr);
+        size_t n = bni_real_len(&a);
 
-            // append to quotient
-            if (q_out != NULL) {
-                q_result.digits_end[i] = cq1;
+        if (n >= BN_HGCD_THRESHOLD && bni_real_len(&b) > n / 2 + 1) {
+            BignumMatrix M;
+            bni_hgcd(&M, &a, &b);
+            if (s_out != NULL) {
+                bnm_lincomb(&x, &y, &M);
             }
+            bnm_free(&M);
 
-            i -= 1;
+            // hgcd always makes progress here, this is just insurance
+            if (bni_real_len(&a) < n || bn_equals_zero(&b)) {
+                continue;
+            }
         }
 
-        // final remainder
-        if (r_out != NULL) {
-            r_result.digits_end[0] = cr;
-        }
+        bni_gcd_step(&a, &b,
+            s_out != NULL ? &x : NULL,
+            s_out != NULL ? &y : NULL,
+            NULL);
     }
 
-    // return result
-    if (q_out != NULL) {
-        bni_try_free(q_out);
-        *q_out = q_result;
-        bni_normalize(q_out);
-    }
-    if (r_out != NULL) {
-        bni_try_free(r_out);
-        *r_out = r_result;
-        bni_normalize(r_out);
+    bni_unshare(&a);
+    bni_try_free(g_out);
+    *g_out = a;
+
+    if (s_out != NULL) {
+        bni_try_free(s_out);
+        *s_out = x;
     }
+    bn_free(&b, &y);
 }
 
 void bni_divqr_Nx2(Bignum* q_out, Bignum* r_out,
@@ -1333,12 +4300,13 @@ size_t bnu_print_digit(bn_digit_t digit_value,
                          bool print_leading_zeroes,
                          bool use_uppercase_digits)
 {
+    // a zero digit still prints one character
     bn_digit_t d = digit_value;
     uint32_t n = 0;
-    while (d > 0) {
+    do {
         d /= base;
         n += 1;
-    }
+    } while (d > 0);
     size_t n_digits = BN_BASE[base].width - n;
 
     size_t nc = 0;
@@ -27,6 +27,7 @@ typedef struct {
     size_t capacity;            // total length of digits_end
     bn_base_t base;             // valid range [2,36]
     uint8_t signbit;            // 1 means negative
+    uint8_t borrowed;           // digits_end belongs to another Bignum
 } Bignum;
 
 // definition: fake_base^width = real_base < UINT32_MAX < fake_base^(width+1)
@@ -37,10 +38,39 @@ typedef struct {
     char last_digit[2];         // stores lower and uppercase digits
 } BignumBase;
 
+// montgomery reduction context for one fixed modulus m, with R = real_base^n
+// only exists when gcd(m, real_base) == 1
+typedef struct {
+    Bignum m;                   // the modulus, n digits
+    size_t n;
+    bn_digit_t m_inv;           // -m^-1 mod real_base
+    Bignum r2;                  // R^2 mod m, converts into montgomery form
+} BignumMont;
+
+// barrett reduction context for one fixed modulus m, works for any m > 0
+typedef struct {
+    Bignum m;                   // the modulus, n digits
+    size_t n;
+    Bignum mu;                  // real_base^2n // m
+} BignumBarrett;
+
 #define BN_BASE_MIN     2
 #define BN_BASE_MAX     36
 #define BN_BASE_DEFAULT 10
 
+// tuning - operand sizes (in digits) where the subquadratic kernels take over
+#define BN_MUL_KARATSUBA_THRESHOLD 32
+#define BN_SQR_KARATSUBA_THRESHOLD 48
+#define BN_HGCD_THRESHOLD          120
+#define BN_DIV_NEWTON_THRESHOLD    120
+
+// shorter operand size (in digits) where multiplies start using threads
+#define BN_MUL_PARALLEL_THRESHOLD  2048
+#define BN_CONVERT_DC_THRESHOLD    64
+
+// printing - characters per write to stdout
+#define BN_PRINT_CHUNK 4096
+
 // base lookup table
 extern const BignumBase BN_BASE[BN_BASE_MAX + 1];
 
@@ -90,6 +120,13 @@ typedef struct {
     void* (*malloc_hook)(size_t);
     void* (*realloc_hook)(void*, size_t);
     void  (*free_hook)(void*);
+
+    // threads for the parallel kernels - spawn_hook runs fn(arg) on another
+    // thread and returns a handle for join_hook, which waits for it
+    // with no hooks or n_threads < 2 everything runs on the calling thread
+    size_t n_threads;
+    void* (*spawn_hook)(void (*fn)(void*), void* arg);
+    void  (*join_hook)(void* handle);
 } BignumConfig;
 
 extern BignumConfig BN_CONFIG;
@@ -145,6 +182,9 @@ bool bn_equals_zero(const Bignum* a0);
 int bn_cmp(const Bignum* a0, const Bignum* a1);
 
 // basic arithmetic methods
+// result may be one of the operands - for bn_neg, bn_add, bn_sub and the
+// word versions of add, sub and mul its digits are then reused for the
+// result when there's room
 
 // result = -a0
 void bn_neg(Bignum* result,
@@ -160,11 +200,27 @@ void bn_sub(Bignum* result,
             const Bignum* a0,
             const Bignum* a1);
 
+// result = args[0] + args[1] + ... + args[n - 1]
+// mixed bases are coerced the same as a left to right chain of bn_add
+void bn_sum(Bignum* result,
+            const Bignum* args,
+            size_t n);
+
 // result = a0 * a1
 void bn_mul(Bignum* result,
             const Bignum* a0,
             const Bignum* a1);
 
+// result = a0 * a0
+void bn_sqr(Bignum* result,
+            const Bignum* a0);
+
+// result = a0 ^ a1
+// returns false if a1 < 0 or a1 does not fit in 64 bits
+bool bn_pow(Bignum* result,
+            const Bignum* a0,
+            const Bignum* a1);
+
 // result_div = a0 // a1 (integer division)
 // result_mod = a0 % a1
 // returns false if a1 == 0
@@ -173,6 +229,115 @@ bool bn_divmod(Bignum* result_div, Bignum* result_mod,
                const Bignum* a0,
                const Bignum* a1);
 
+// word operands - a1 is a plain integer, it takes the base of a0 so there's
+// no base coercion and the result is in the base of a0
+// an a1 below the real_base of a0 is never put in a Bignum, the digits of a0
+// are worked on directly
+
+// result = a0 + a1
+void bn_add_ui(Bignum* result,
+               const Bignum* a0,
+               uint64_t a1);
+
+// result = a0 - a1
+void bn_sub_ui(Bignum* result,
+               const Bignum* a0,
+               uint64_t a1);
+
+// result = a0 * a1
+void bn_mul_ui(Bignum* result,
+               const Bignum* a0,
+               uint64_t a1);
+
+// result_div = a0 // a1, result_mod = a0 % a1, rounded the same as bn_divmod
+// returns false if a1 == 0
+// both results can optionally be NULL
+bool bn_divmod_ui(Bignum* result_div, Bignum* result_mod,
+                  const Bignum* a0,
+                  uint64_t a1);
+
+// -1 => a0 < a1
+// 0 => a0 == a1
+// 1 => a0 > a1
+int bn_cmp_ui(const Bignum* a0, uint64_t a1);
+
+// result = floor(sqrt(a0))
+// returns false if a0 < 0
+bool bn_isqrt(Bignum* result, const Bignum* a0);
+
+// result = floor(a0 ^ (1/n)), rounded toward zero for a0 < 0
+// returns false if n == 0, or if a0 < 0 and n is even
+bool bn_iroot(Bignum* result, const Bignum* a0, uint64_t n);
+
+// result = a0!
+// returns false if a0 < 0 or a0 > UINT32_MAX
+bool bn_fact(Bignum* result, const Bignum* a0);
+
+// result = a0! / (a1! (a0 - a1)!), 0 if a1 < 0 or a1 > a0
+// returns false if a0 < 0, or if it's too big to compute
+bool bn_binom(Bignum* result, const Bignum* a0, const Bignum* a1);
+
+// result = F(a0), the a0th fibonacci number, also for a0 < 0
+// returns false if a0 does not fit in 64 bits
+bool bn_fib(Bignum* result, const Bignum* a0);
+
+// result = L(a0), the a0th lucas number, also for a0 < 0
+// returns false if a0 does not fit in 64 bits
+bool bn_lucas(Bignum* result, const Bignum* a0);
+
+// result = floor(pi * base^a0), pi to a0 digits in the base of a0
+// returns false if a0 < 0 or a0 > UINT32_MAX
+bool bn_pi(Bignum* result, const Bignum* a0);
+
+// result = floor(e * base^a0), e to a0 digits in the base of a0
+// returns false if a0 < 0 or a0 > UINT32_MAX
+bool bn_e(Bignum* result, const Bignum* a0);
+
+// modular arithmetic
+
+// set up montgomery reduction for the modulus m
+// returns false if m <= 1 or m shares a factor with its real_base
+bool bn_mont_init(BignumMont* mont, const Bignum* m);
+
+// free a montgomery context
+void bn_mont_free(BignumMont* mont);
+
+// set up barrett reduction for the modulus m
+// returns false if m <= 0
+bool bn_barrett_init(BignumBarrett* br, const Bignum* m);
+
+// free a barrett context
+void bn_barrett_free(BignumBarrett* br);
+
+// result = a0 % br->m, always in [0, m) even if a0 < 0
+// one multiply-and-shift if a0 has at most 2n digits, else a long division
+void bn_barrett_reduce(Bignum* result,
+                       const BignumBarrett* br,
+                       const Bignum* a0);
+
+// result = (a0 ^ a1) % m, every intermediate stays the size of m
+// returns false if a1 < 0 or m <= 0
+bool bn_powmod(Bignum* result,
+               const Bignum* a0,
+               const Bignum* a1,
+               const Bignum* m);
+
+// result = gcd(|a0|, |a1|), gcd(0, 0) = 0
+void bn_gcd(Bignum* result,
+            const Bignum* a0,
+            const Bignum* a1);
+
+// result = lcm(|a0|, |a1|), lcm(0, a1) = 0
+void bn_lcm(Bignum* result,
+            const Bignum* a0,
+            const Bignum* a1);
+
+// result = a0^-1 % m, in [0, m)
+// returns false if m <= 0 or gcd(a0, m) != 1
+bool bn_invmod(Bignum* result,
+               const Bignum* a0,
+               const Bignum* m);
+
 // internal
 
 // get the real length of the bignum, ignoring leading zeroes
@@ -196,15 +361,30 @@ void bni_append_zeros(Bignum* out, size_t n);
 // create a deep copy of src in dest
 void bni_copy(Bignum* dest, const Bignum* src);
 
+// dest = src sharing the digits, for a temporary that may never be written
+// to - only valid while src is, and never frees the digits
+void bni_borrow(Bignum* dest, const Bignum* src);
+
+// copy on write - gives b digits of its own if they're borrowed
+void bni_unshare(Bignum* b);
+
 // copy src to dest, converting to a different base
 // assume new_base in [2,36], != old_base
 // never fails
 void bni_convert(Bignum* dest, const Bignum* src, bn_base_t new_base);
 
+// same as bni_convert, splitting src by powers of the new real_base and
+// converting the halves on their own, on other threads if BN_CONFIG has them
+// used by bni_convert from BN_CONVERT_DC_THRESHOLD digits up
+void bni_convert_dc(Bignum* dest, const Bignum* src, bn_base_t new_base);
+
 // convert base of two arguments based on value of BN_CONFIG.base_coercion_mode
 void bni_handle_bcm(Bignum* first_out, Bignum* last_out,
                     const Bignum* first, const Bignum* last);
 
+// the base a left to right chain of operations on args[0..n) would end up in
+bn_base_t bni_bcm_base(const Bignum* args, size_t n);
+
 // free a single bignum (unless #ifdef BN_NOFREE) and set it to {0}
 void bni_try_free(Bignum* out);
 
@@ -214,6 +394,15 @@ void bni_normalize(Bignum* out);
 // write a string value to a bignum, or return false for parse error
 bool bni_write_str(Bignum* out, const char* str, size_t len, bn_base_t base);
 
+// write fake_base^k in any base to a bignum (a 1 followed by k zeroes)
+void bni_write_base_power(Bignum* out, uint64_t k, bn_base_t base);
+
+// write a u64 value in any base to a bignum
+void bni_write_u64(Bignum* out,
+                   uint8_t signbit,
+                   uint64_t value,
+                   bn_base_t base);
+
 // write a 1-digit value in any base to a bignum
 // returns false for illegal digit value
 bool bni_write_parts1(Bignum* out,
@@ -228,6 +417,13 @@ bool bni_write_parts2(Bignum* out,
                       bn_digit_t d0, bn_digit_t d1,
                       bn_base_t base);
 
+// read the magnitude of b into a u64, ignoring sign
+// returns false if it does not fit
+bool bni_to_u64(const Bignum* b, uint64_t* out);
+
+// is |b| a power of its own fake_base? writes the exponent to k_out
+bool bni_is_base_power(const Bignum* b, uint64_t* k_out);
+
 // print a standard-representation of a bignum to the console w/ options
 // returns # of characters written
 size_t bni_print(const Bignum* b, bool explicit_base, bool uppercase);
@@ -253,6 +449,13 @@ void bni_lshift(Bignum* out, const Bignum* a0, size_t n);
 // assumes n > 0, ignores sign
 void bni_rshift(Bignum* out, const Bignum* a0, size_t n);
 
+// out = a0 * fake_base^k, one pass of a shift and a 1 digit multiply
+void bni_mul_base_power(Bignum* out, const Bignum* a0, uint64_t k);
+
+// out = a0 // fake_base^k
+// assumes a0 >= 0
+void bni_div_base_power(Bignum* out, const Bignum* a0, uint64_t k);
+
 // out = -a0
 // assumes a0 != 0
 void bni_neg(Bignum* out, const Bignum* a0);
@@ -265,10 +468,62 @@ void bni_add(Bignum* out, const Bignum* a0, const Bignum* a1);
 // assumes a0, a1 > 0
 void bni_sub(Bignum* out, const Bignum* a0, const Bignum* a1);
 
+// out = a0 + a1
+// assumes a0 >= 0, a1 < real_base
+void bni_add_1(Bignum* out, const Bignum* a0, bn_digit_t a1);
+
+// out = a0 - a1
+// assumes a0 >= a1, a1 < real_base
+void bni_sub_1(Bignum* out, const Bignum* a0, bn_digit_t a1);
+
+// out = args[0] + ... + args[n - 1], signs included
+// assumes n > 0 and all args are in the same base
+void bni_sum(Bignum* out, const Bignum* args, size_t n);
+
 // out = a0 * a1
 // assumes a0, a1 > 0
 void bni_mul(Bignum* out, const Bignum* a0, const Bignum* a1);
 
+// out = a0 * a1, one pass over the digits of a0
+// assumes a0 >= 0, a1 < real_base
+void bni_mul_1(Bignum* out, const Bignum* a0, bn_digit_t a1);
+
+// out = a0 * a0
+// assumes a0 > 0
+void bni_sqr(Bignum* out, const Bignum* a0);
+
+// out = a0 ^ e
+// assumes a0 > 0, e > 0
+void bni_pow(Bignum* out, const Bignum* a0, uint64_t e);
+
+// out = floor(a0 ^ (1/k))
+// newton's method, started from the root of the top half of a0
+// assumes a0 > 0, k >= 2
+void bni_iroot(Bignum* out, const Bignum* a0, uint64_t k);
+
+// out = n!
+// prime factorization with balanced product trees
+void bni_fact(Bignum* out, uint64_t n, bn_base_t base);
+
+// out = n! / (k! (n - k)!)
+// prime factorization with balanced product trees
+// assumes k <= n
+void bni_binom(Bignum* out, uint64_t n, uint64_t k, bn_base_t base);
+
+// f_out = F(n), f1_out = F(n - 1)
+// fast doubling, two squares per bit of n
+// assumes n > 0
+void bni_fib(Bignum* f_out, Bignum* f1_out, uint64_t n, bn_base_t base);
+
+// out = floor(pi * base^digits)
+// chudnovsky's series by binary splitting, then one square root and one
+// division at full size
+void bni_pi(Bignum* out, uint64_t digits, bn_base_t base);
+
+// out = floor(e * base^digits)
+// taylor series by binary splitting, then one division at full size
+void bni_e(Bignum* out, uint64_t digits, bn_base_t base);
+
 // q_out = a0 // a1 (integer division)
 // r_out = a0 % a1 (remainder)
 // assumes 0 > a1 > a0
@@ -276,12 +531,160 @@ void bni_divqr_Nx1(Bignum* q_out, Bignum* r_out,
                    const Bignum* a0,
                    bn_digit_t a1);
 
+// g_out = gcd(a0, a1)
+// if s_out is not NULL, s_out = s with s * a1 == g_out (mod a0), |s| < a0
+// lehmer's algorithm, with half-gcd above BN_HGCD_THRESHOLD digits
+// assumes a0 >= a1 >= 0, same base
+void bni_gcd(Bignum* g_out, Bignum* s_out,
+             const Bignum* a0,
+             const Bignum* a1);
+
 // TODO write this one
 // same as above but a1 is assumed to be 2 digits and same base as a0
 void bni_divqr_Nx2(Bignum* q_out, Bignum* r_out,
                    const Bignum* a0,
                    const Bignum* a1);
 
+// same as bni_divqr_Nx1 but a1 has 2+ digits and the same base as a0
+// assumes 0 <= a0 and 0 < a1, a0 shorter than a1 gives [0, a0]
+void bni_divqr_NxM(Bignum* q_out, Bignum* r_out,
+                   const Bignum* a0,
+                   const Bignum* a1);
+
+// same as bni_divqr_NxM, in a few multiplications by the reciprocal of a1
+// assumes 0 < a1 <= a0, both at least BN_DIV_NEWTON_THRESHOLD digits
+void bni_divqr_newton(Bignum* q_out, Bignum* r_out,
+                      const Bignum* a0,
+                      const Bignum* a1);
+
+// out = real_base^2n // a0, where a0 has n digits
+// newton's method, started from the reciprocal of the top half of a0
+// assumes a0 > 0
+void bni_recip(Bignum* out, const Bignum* a0);
+
+// out = a0 % br->m
+// assumes 0 <= a0 < real_base^2n, a0 in the same base as br->m
+void bni_barrett_reduce(Bignum* out,
+                        const BignumBarrett* br,
+                        const Bignum* a0);
+
+// q_out = a0 // br->m, r_out = a0 % br->m, both can be NULL
+// assumes 0 <= a0 < real_base^2n, a0 in the same base as br->m
+void bni_barrett_divqr(Bignum* q_out, Bignum* r_out,
+                       const BignumBarrett* br,
+                       const Bignum* a0);
+
+// out = (a0 ^ e) % mont->m, e is any base
+// assumes 0 <= a0 < mont->m, e > 0, a0 in the same base as mont->m
+void bni_mont_powmod(Bignum* out, const BignumMont* mont,
+                     const Bignum* a0,
+                     const Bignum* e);
+
+// limb arrays
+
+// little-endian runs of digits in one real_base, addressed by pointer +
+// length. nothing here allocates, scratch space comes from the caller, so
+// a recursive algorithm can run in one workspace allocated up front
+// the bni_** arithmetic above is built on these
+
+// length of a with leading zeroes stripped, at least 1
+size_t bnl_real_len(const bn_digit_t* a, size_t n);
+
+// compare a and b, both n digits, returns -1, 0 or 1
+int bnl_cmp(const bn_digit_t* a, const bn_digit_t* b, size_t n);
+
+// r = a + b, returns the carry out
+// assumes an >= bn, r has room for an digits (r may alias a or b)
+bn_digit_t bnl_add(bn_digit_t* r,
+                   const bn_digit_t* a, size_t an,
+                   const bn_digit_t* b, size_t bn,
+                   bn_digit_t real_base);
+
+// r = a + x, returns the carry out
+// assumes x < real_base, r has room for n digits (r may alias a)
+bn_digit_t bnl_add_1(bn_digit_t* r,
+                     const bn_digit_t* a, size_t n,
+                     bn_digit_t x,
+                     bn_digit_t real_base);
+
+// r = a - b, returns the borrow out
+// assumes an >= bn, r has room for an digits (r may alias a or b)
+bn_digit_t bnl_sub(bn_digit_t* r,
+                   const bn_digit_t* a, size_t an,
+                   const bn_digit_t* b, size_t bn,
+                   bn_digit_t real_base);
+
+// r = a - x, returns the borrow out
+// assumes x < real_base, r has room for n digits (r may alias a)
+bn_digit_t bnl_sub_1(bn_digit_t* r,
+                     const bn_digit_t* a, size_t n,
+                     bn_digit_t x,
+                     bn_digit_t real_base);
+
+// r = a * x, returns the digit carried out of the top
+// assumes x < real_base, r has room for n digits (r may alias a)
+bn_digit_t bnl_mul_1(bn_digit_t* r,
+                     const bn_digit_t* a, size_t n,
+                     bn_digit_t x,
+                     bn_digit_t real_base);
+
+// q = a // d, returns a % d
+// d is any digit, it doesn't have to be below real_base
+// assumes d > 0, q has room for n digits or is NULL (q may alias a)
+bn_digit_t bnl_divrem_1(bn_digit_t* q,
+                        const bn_digit_t* a, size_t n,
+                        bn_digit_t d,
+                        bn_digit_t real_base);
+
+// scratch digits needed by bnl_mul when the longer operand has an digits
+// (an upper bound - it also covers every unbalanced split below it)
+size_t bnl_mul_scratch_len(size_t an);
+
+// r = a * b, karatsuba above BN_MUL_KARATSUBA_THRESHOLD:
+// (a1*B^k + a0)(b1*B^k + b0)
+//     = a1b1*B^2k + ((a0 + a1)(b0 + b1) - a0b0 - a1b1)*B^k + a0b0
+// when b is less than half as long as a, a is cut into b-sized pieces
+// assumes an >= bn, r has room for an + bn digits, does not alias a or b,
+// scratch has bnl_mul_scratch_len(an)
+void bnl_mul(bn_digit_t* r,
+             const bn_digit_t* a, size_t an,
+             const bn_digit_t* b, size_t bn,
+             bn_digit_t real_base,
+             bn_digit_t* scratch);
+
+// scratch digits needed by bnl_sqr for an n digit operand
+size_t bnl_sqr_scratch_len(size_t n);
+
+// r = a^2, karatsuba above BN_SQR_KARATSUBA_THRESHOLD:
+// (a1*B^k + a0)^2 = a1^2*B^2k + ((a0 + a1)^2 - a0^2 - a1^2)*B^k + a0^2
+// assumes r has room for 2n digits, does not alias a,
+// scratch has bnl_sqr_scratch_len(n)
+void bnl_sqr(bn_digit_t* r,
+             const bn_digit_t* a, size_t n,
+             bn_digit_t real_base,
+             bn_digit_t* scratch);
+
+// scratch digits needed by bnl_divrem
+size_t bnl_divrem_scratch_len(size_t an, size_t bn);
+
+// q = a // b, r = a % b, knuth's algorithm D
+// q has an - bn + 1 digits and r has bn digits, either can be NULL
+// assumes an >= bn, b[bn - 1] != 0, q and r do not alias a or b,
+// scratch has bnl_divrem_scratch_len(an, bn)
+void bnl_divrem(bn_digit_t* q, bn_digit_t* r,
+                const bn_digit_t* a, size_t an,
+                const bn_digit_t* b, size_t bn,
+                bn_digit_t real_base,
+                bn_digit_t* scratch);
+
+// out = x converted from x_real_base to real_base, zero padded to out_len
+// x is used as the workspace, it's 0 afterwards
+// assumes out_len is enough for x in the new base
+void bnl_convert(bn_digit_t* out, size_t out_len,
+                 bn_digit_t* x, size_t n,
+                 bn_digit_t x_real_base,
+                 bn_digit_t real_base);
+
 // utils
 
 uint64_t bnu_min(uint64_t x, uint64_t y);
@@ -1,5 +1,21 @@
 #include "apc.h"
 
+// a single digit operand goes to the bn_*_ui functions as a word, as long as
+// the other one is already in the base the result would be coerced to
+// returns the operand that can, a1 first, or NULL
+static const Bignum* word_operand(const Bignum* a0, const Bignum* a1) {
+    Bignum args[2] = { *a0, *a1 };
+    bn_base_t base = bni_bcm_base(args, 2);
+
+    if (bni_real_len(a1) == 1 && a0->base == base) {
+        return a1;
+    }
+    if (bni_real_len(a0) == 1 && a1->base == base) {
+        return a0;
+    }
+    return NULL;
+}
+
 // unary operators
 
 // +a0 : Num => Num
@@ -8,10 +24,8 @@ Value UnopFn_Plus(Value a0) {
         apc_return(E_VALUE_ERROR);
     }
 
-    Value result = { .type = V_NUMBER };
-    bn_copy(&result.number, &a0.number);
-
-    return result;
+    // values are never written to, so the result can share the digits
+    return a0;
 }
 
 // -a0 : Num => Num
@@ -20,6 +34,12 @@ Value UnopFn_Minus(Value a0) {
         apc_return(E_VALUE_ERROR);
     }
 
+    // an owned operand is negated in place
+    if (a0.owned) {
+        bn_neg(&a0.number, &a0.number);
+        return a0;
+    }
+
     Value result = { .type = V_NUMBER };
     bn_neg(&result.number,
         &a0.number);
@@ -33,7 +53,24 @@ Value BinopFn_Add(Value a0, Value a1) {
         apc_return(E_VALUE_ERROR);
     }
 
+    // the result goes over an owned operand if there's room
     Value result = { .type = V_NUMBER };
+    if (a0.owned || a1.owned) {
+        result = a0.owned ? a0 : a1;
+    }
+
+    // x + (+-w) => x +- w
+    const Bignum* w = word_operand(&a0.number, &a1.number);
+    if (w != NULL) {
+        const Bignum* x = (w == &a1.number) ? &a0.number : &a1.number;
+        if (w->signbit) {
+            bn_sub_ui(&result.number, x, w->digits_end[0]);
+        } else {
+            bn_add_ui(&result.number, x, w->digits_end[0]);
+        }
+        return result;
+    }
+
     bn_add(&result.number,
         &a0.number,
         &a1.number);
@@ -47,7 +84,33 @@ Value BinopFn_Sub(Value a0, Value a1) {
         apc_return(E_VALUE_ERROR);
     }
 
+    // the result goes over an owned operand if there's room
     Value result = { .type = V_NUMBER };
+    if (a0.owned || a1.owned) {
+        result = a0.owned ? a0 : a1;
+    }
+
+    const Bignum* w = word_operand(&a0.number, &a1.number);
+    if (w == &a1.number) {
+        // x - (+-w) => x -+ w
+        if (w->signbit) {
+            bn_add_ui(&result.number, &a0.number, w->digits_end[0]);
+        } else {
+            bn_sub_ui(&result.number, &a0.number, w->digits_end[0]);
+        }
+        return result;
+    }
+    if (w == &a0.number) {
+        // (+-w) - x => -(x -+ w)
+        if (w->signbit) {
+            bn_add_ui(&result.number, &a1.number, w->digits_end[0]);
+        } else {
+            bn_sub_ui(&result.number, &a1.number, w->digits_end[0]);
+        }
+        bn_neg(&result.number, &result.number);
+        return result;
+    }
+
     bn_sub(&result.number,
         &a0.number,
         &a1.number);
@@ -62,6 +125,21 @@ Value BinopFn_Mul(Value a0, Value a1) {
     }
 
     Value result = { .type = V_NUMBER };
+
+    // x * (+-w) => +-(x * w), over x if it's owned
+    const Bignum* w = word_operand(&a0.number, &a1.number);
+    if (w != NULL) {
+        Value* x = (w == &a1.number) ? &a0 : &a1;
+        if (x->owned) {
+            result = *x;
+        }
+        bn_mul_ui(&result.number, &x->number, w->digits_end[0]);
+        if (w->signbit) {
+            bn_neg(&result.number, &result.number);
+        }
+        return result;
+    }
+
     bn_mul(&result.number,
         &a0.number,
         &a1.number);
@@ -76,9 +154,25 @@ Value BinopFn_Div(Value a0, Value a1) {
     }
 
     Value result = { .type = V_NUMBER };
-    bn_divmod(&result.number, NULL,
+
+    // a single digit divisor => one pass over a0
+    if (word_operand(&a0.number, &a1.number) == &a1.number
+    && !a1.number.signbit) {
+        if (!bn_divmod_ui(&result.number, NULL,
+            &a0.number,
+            a1.number.digits_end[0])) {
+            // division by zero
+            apc_return(E_VALUE_ERROR);
+        }
+        return result;
+    }
+
+    if (!bn_divmod(&result.number, NULL,
         &a0.number,
-        &a1.number);
+        &a1.number)) {
+        // division by zero
+        apc_return(E_VALUE_ERROR);
+    }
 
     return result;
 }
@@ -90,9 +184,42 @@ Value BinopFn_Mod(Value a0, Value a1) {
     }
 
     Value result = { .type = V_NUMBER };
-    bn_divmod(NULL, &result.number,
+
+    // a single digit divisor => one pass over a0
+    if (word_operand(&a0.number, &a1.number) == &a1.number
+    && !a1.number.signbit) {
+        if (!bn_divmod_ui(NULL, &result.number,
+            &a0.number,
+            a1.number.digits_end[0])) {
+            // division by zero
+            apc_return(E_VALUE_ERROR);
+        }
+        return result;
+    }
+
+    if (!bn_divmod(NULL, &result.number,
         &a0.number,
-        &a1.number);
+        &a1.number)) {
+        // division by zero
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// a0 ^ a1 : (Num, Num) => Num
+Value BinopFn_Pow(Value a0, Value a1) {
+    if (a0.type != V_NUMBER || a1.type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_pow(&result.number,
+        &a0.number,
+        &a1.number)) {
+        // negative or absurdly large exponent
+        apc_return(E_VALUE_ERROR);
+    }
 
     return result;
 }
@@ -110,6 +237,11 @@ Value BinopFn_BaseConv(Value a0, Value b) {
 
     bn_digit_t base = b.number.digits_end[0];
 
+    // already in that base, share the digits
+    if (base == a0.number.base) {
+        return a0;
+    }
+
     Value result = { .type = V_NUMBER };
     if (!bn_convert(&result.number, &a0.number, base)) {
         // base out of range
@@ -118,3 +250,220 @@ Value BinopFn_BaseConv(Value a0, Value b) {
 
     return result;
 }
+
+// functions
+
+// powmod(a0, a1, m) : (Num, Num, Num) => Num
+Value FuncFn_PowMod(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER
+    || a[1].type != V_NUMBER
+    || a[2].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_powmod(&result.number,
+        &a[0].number,
+        &a[1].number,
+        &a[2].number)) {
+        // negative exponent or modulus <= 0
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// mod(m, a0) : (Num, Num) => Num
+// the compiler handles mod() calls in expressions, this is the plain version
+Value FuncFn_Mod(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER || a[1].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    BignumBarrett br;
+    if (!bn_barrett_init(&br, &a[0].number)) {
+        // m <= 0
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    bn_barrett_reduce(&result.number, &br, &a[1].number);
+    bn_barrett_free(&br);
+
+    return result;
+}
+
+// gcd(a0, a1) : (Num, Num) => Num
+Value FuncFn_Gcd(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER || a[1].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    bn_gcd(&result.number, &a[0].number, &a[1].number);
+    return result;
+}
+
+// lcm(a0, a1) : (Num, Num) => Num
+Value FuncFn_Lcm(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER || a[1].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    bn_lcm(&result.number, &a[0].number, &a[1].number);
+    return result;
+}
+
+// invmod(a0, m) : (Num, Num) => Num
+Value FuncFn_InvMod(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER || a[1].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_invmod(&result.number, &a[0].number, &a[1].number)) {
+        // modulus <= 0 or no inverse
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// isqrt(a0) : (Num) => Num
+Value FuncFn_ISqrt(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_isqrt(&result.number, &a[0].number)) {
+        // a0 < 0
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// iroot(a0, n) : (Num, Num) => Num
+Value FuncFn_IRoot(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER || a[1].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    uint64_t n;
+    if (a[1].number.signbit || !bni_to_u64(&a[1].number, &n)) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_iroot(&result.number, &a[0].number, n)) {
+        // n == 0, or a0 < 0 with an even n
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// fact(a0) : (Num) => Num
+Value FuncFn_Fact(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_fact(&result.number, &a[0].number)) {
+        // a0 < 0 or way too big
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// binom(a0, a1) : (Num, Num) => Num
+Value FuncFn_Binom(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER || a[1].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_binom(&result.number, &a[0].number, &a[1].number)) {
+        // a0 < 0 or way too big
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// fib(a0) : (Num) => Num
+Value FuncFn_Fib(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_fib(&result.number, &a[0].number)) {
+        // way too big
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// lucas(a0) : (Num) => Num
+Value FuncFn_Lucas(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_lucas(&result.number, &a[0].number)) {
+        // way too big
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// pi(a0) : (Num) => Num
+Value FuncFn_Pi(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_pi(&result.number, &a[0].number)) {
+        // a0 < 0 or way too big
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
+
+// e(a0) : (Num) => Num
+Value FuncFn_E(FuncArgs args) {
+    Value* a = args.args;
+    if (a[0].type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+    if (!bn_e(&result.number, &a[0].number)) {
+        // a0 < 0 or way too big
+        apc_return(E_VALUE_ERROR);
+    }
+
+    return result;
+}
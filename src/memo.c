@@ -0,0 +1,241 @@
+#include "apc.h"
+
+#include <pthread.h>
+
+typedef struct MemoEntry {
+    struct MemoEntry* chain;    // next one in the same bucket
+
+    // recency list, newest at the head
+    struct MemoEntry* newer;
+    struct MemoEntry* older;
+
+    uint64_t hash;
+    uint64_t tag;
+    Value* args;
+    size_t n_args;
+    Value result;
+    size_t size;                // bytes it counts against the budget
+} MemoEntry;
+
+typedef struct {
+    MemoEntry** buckets;
+    size_t n_buckets;
+    size_t n_entries;
+
+    MemoEntry* newest;
+    MemoEntry* oldest;
+
+    size_t size;
+    size_t budget;
+
+    // operations run on the pool threads too
+    pthread_mutex_t lock;
+} Memo;
+
+static Memo memo = {
+    .budget = MEMO_DEFAULT_BUDGET,
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static uint64_t memo_mix(uint64_t h, uint64_t x) {
+    return (h ^ x) * 1099511628211ull;
+}
+
+static uint64_t memo_hash(const MemoKey* key) {
+    uint64_t h = 14695981039346656037ull;
+    h = memo_mix(h, key->tag);
+    h = memo_mix(h, key->n_args);
+    for (size_t i = 0; i < key->n_args; i++) {
+        const Bignum* b = &key->args[i].number;
+        size_t len = bni_real_len(b);
+        h = memo_mix(h, b->base);
+        h = memo_mix(h, b->signbit);
+        h = memo_mix(h, len);
+        for (size_t k = 0; k < len; k++) {
+            h = memo_mix(h, b->digits_end[k]);
+        }
+    }
+    return h;
+}
+
+static bool memo_value_equals(const Value* a, const Value* b) {
+    size_t len = bni_real_len(&a->number);
+    return a->type == b->type
+        && a->number.base == b->number.base
+        && a->number.signbit == b->number.signbit
+        && bni_real_len(&b->number) == len
+        && !memcmp(a->number.digits_end, b->number.digits_end,
+                   len * sizeof(bn_digit_t));
+}
+
+static bool memo_matches(const MemoEntry* m, uint64_t hash,
+                         const MemoKey* key) {
+    if (m->hash != hash || m->tag != key->tag || m->n_args != key->n_args) {
+        return false;
+    }
+    for (size_t i = 0; i < key->n_args; i++) {
+        if (!memo_value_equals(&m->args[i], &key->args[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static MemoEntry** memo_bucket(uint64_t hash) {
+    return &memo.buckets[hash & (memo.n_buckets - 1)];
+}
+
+static void memo_unlink(MemoEntry* m) {
+    *(m->newer ? &m->newer->older : &memo.newest) = m->older;
+    *(m->older ? &m->older->newer : &memo.oldest) = m->newer;
+}
+
+static void memo_push_newest(MemoEntry* m) {
+    m->newer = NULL;
+    m->older = memo.newest;
+    *(memo.newest ? &memo.newest->newer : &memo.oldest) = m;
+    memo.newest = m;
+}
+
+static void memo_remove(MemoEntry* m) {
+    MemoEntry** p = memo_bucket(m->hash);
+    while (*p != m) {
+        p = &(*p)->chain;
+    }
+    *p = m->chain;
+    memo_unlink(m);
+    memo.n_entries -= 1;
+    memo.size -= m->size;
+
+    for (size_t i = 0; i < m->n_args; i++) {
+        value_free_persistent(&m->args[i]);
+    }
+    value_free_persistent(&m->result);
+    apc_free_persistent(m->args);
+    apc_free_persistent(m);
+}
+
+// drop the least recently used results until it fits in the budget
+static void memo_evict(size_t budget) {
+    while (memo.size > budget) {
+        memo_remove(memo.oldest);
+    }
+}
+
+// double the buckets and put every entry back
+static void memo_grow() {
+    size_t n_buckets = memo.n_buckets ? 2 * memo.n_buckets : 64;
+    MemoEntry** buckets = apc_malloc_persistent(n_buckets * sizeof(MemoEntry*));
+    memset(buckets, 0, n_buckets * sizeof(MemoEntry*));
+
+    for (size_t i = 0; i < memo.n_buckets; i++) {
+        MemoEntry* m = memo.buckets[i];
+        while (m != NULL) {
+            MemoEntry* next = m->chain;
+            MemoEntry** b = &buckets[m->hash & (n_buckets - 1)];
+            m->chain = *b;
+            *b = m;
+            m = next;
+        }
+    }
+
+    apc_free_persistent(memo.buckets);
+    memo.buckets = buckets;
+    memo.n_buckets = n_buckets;
+}
+
+static size_t memo_value_size(const Value* v) {
+    return bni_real_len(&v->number) * sizeof(bn_digit_t);
+}
+
+void memo_set_budget(size_t bytes) {
+    pthread_mutex_lock(&memo.lock);
+    memo.budget = bytes;
+    memo_evict(bytes);
+    pthread_mutex_unlock(&memo.lock);
+}
+
+bool memo_find(const MemoKey* key, Value* out) {
+    if (memo.budget == 0) {
+        return false;
+    }
+    uint64_t hash = memo_hash(key);
+
+    pthread_mutex_lock(&memo.lock);
+    MemoEntry* m = memo.n_buckets ? *memo_bucket(hash) : NULL;
+    while (m != NULL && !memo_matches(m, hash, key)) {
+        m = m->chain;
+    }
+
+    if (m != NULL) {
+        memo_unlink(m);
+        memo_push_newest(m);
+
+        // a copy, the entry can be evicted while the copy is still in use
+        size_t len = bni_real_len(&m->result.number);
+        *out = m->result;
+        out->number.digits_end = apc_malloc(len * sizeof(bn_digit_t));
+        out->number.capacity = len;
+        memcpy(out->number.digits_end, m->result.number.digits_end,
+               len * sizeof(bn_digit_t));
+    }
+    pthread_mutex_unlock(&memo.lock);
+
+    return m != NULL;
+}
+
+void memo_insert(const MemoKey* key, const Value* result) {
+    if (result->type != V_NUMBER) {
+        return;
+    }
+
+    size_t size = sizeof(MemoEntry) + memo_value_size(result);
+    size_t len = bni_real_len(&result->number);
+    for (size_t i = 0; i < key->n_args; i++) {
+        size += sizeof(Value) + memo_value_size(&key->args[i]);
+        len += bni_real_len(&key->args[i].number);
+    }
+    if (len < MEMO_MIN_LEN || size > memo.budget) {
+        return;
+    }
+    uint64_t hash = memo_hash(key);
+
+    pthread_mutex_lock(&memo.lock);
+
+    // another thread may have just done the same operation
+    MemoEntry* m = memo.n_buckets ? *memo_bucket(hash) : NULL;
+    while (m != NULL && !memo_matches(m, hash, key)) {
+        m = m->chain;
+    }
+    if (m != NULL) {
+        pthread_mutex_unlock(&memo.lock);
+        return;
+    }
+
+    memo_evict(memo.budget - size);
+    if (memo.n_entries >= memo.n_buckets) {
+        memo_grow();
+    }
+
+    m = apc_malloc_persistent(sizeof(MemoEntry));
+    *m = (MemoEntry){
+        .hash = hash,
+        .tag = key->tag,
+        .args = apc_malloc_persistent((key->n_args + 1) * sizeof(Value)),
+        .n_args = key->n_args,
+        .result = value_copy_persistent(result),
+        .size = size
+    };
+    for (size_t i = 0; i < key->n_args; i++) {
+        m->args[i] = value_copy_persistent(&key->args[i]);
+    }
+
+    MemoEntry** b = memo_bucket(hash);
+    m->chain = *b;
+    *b = m;
+    memo_push_newest(m);
+    memo.n_entries += 1;
+    memo.size += size;
+
+    pthread_mutex_unlock(&memo.lock);
+}
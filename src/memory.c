@@ -1,6 +1,77 @@
 #include "memory.h"
 
+#include <pthread.h>
+#include <stddef.h>
+
+// every apc_malloc() block sits in one list behind this header
+typedef union Block {
+    struct {
+        union Block* prev;
+        union Block* next;
+    };
+    max_align_t align;
+} Block;
+
+static Block blocks = { .prev = &blocks, .next = &blocks };
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void block_link(Block* b) {
+    pthread_mutex_lock(&blocks_lock);
+    b->prev = &blocks;
+    b->next = blocks.next;
+    blocks.next->prev = b;
+    blocks.next = b;
+    pthread_mutex_unlock(&blocks_lock);
+}
+
+static void block_unlink(Block* b) {
+    pthread_mutex_lock(&blocks_lock);
+    b->prev->next = b->next;
+    b->next->prev = b->prev;
+    pthread_mutex_unlock(&blocks_lock);
+}
+
 void* apc_malloc(size_t size) {
+    Block* b = apc_malloc_persistent(sizeof(Block) + size);
+    block_link(b);
+    return b + 1;
+}
+
+void* apc_realloc(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return apc_malloc(size);
+    }
+
+    Block* b = (Block*)ptr - 1;
+    block_unlink(b);
+    b = apc_realloc_persistent(b, sizeof(Block) + size);
+    block_link(b);
+    return b + 1;
+}
+
+void apc_free(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    Block* b = (Block*)ptr - 1;
+    block_unlink(b);
+    free(b);
+}
+
+void apc_free_all() {
+    pthread_mutex_lock(&blocks_lock);
+    Block* b = blocks.next;
+    while (b != &blocks) {
+        Block* next = b->next;
+        free(b);
+        b = next;
+    }
+    blocks.prev = blocks.next = &blocks;
+    pthread_mutex_unlock(&blocks_lock);
+}
+
+void* apc_malloc_persistent(size_t size) {
     void* m = malloc(size);
     if (m == NULL) {
         fputs(" = memory error\n", stdout);
@@ -9,7 +80,7 @@ void* apc_malloc(size_t size) {
     return m;
 }
 
-void* apc_realloc(void* ptr, size_t size) {
+void* apc_realloc_persistent(void* ptr, size_t size) {
     void* r = realloc(ptr, size);
     if (r == NULL) {
         fputs(" = memory error\n", stdout);
@@ -18,7 +89,6 @@ void* apc_realloc(void* ptr, size_t size) {
     return r;
 }
 
-void apc_free(void* ptr) {
+void apc_free_persistent(void* ptr) {
     free(ptr);
 }
-
@@ -11,8 +11,18 @@
 
 extern void apc_exit(int exit_code);
 
+// these belong to the evaluation in progress, apc_free_all() frees whatever
+// it left behind - safe to call from any thread
 void* apc_malloc(size_t size);
 void* apc_realloc(void* ptr, size_t size);
 void apc_free(void* ptr);
 
+// free every block from apc_malloc() and apc_realloc() that's still alive
+void apc_free_all();
+
+// these outlive every evaluation (runtime tables, variables, the thread pool)
+void* apc_malloc_persistent(size_t size);
+void* apc_realloc_persistent(void* ptr, size_t size);
+void apc_free_persistent(void* ptr);
+
 #endif // MEMORY_H
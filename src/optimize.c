@@ -0,0 +1,476 @@
+#include "apc.h"
+
+static bool is_value(const Expr* e) {
+    return e->type == X_VALUE && e->value.type == V_NUMBER;
+}
+
+// literal fake_base^k in its own base, k < 2^32
+static bool is_base_power(const Expr* e, uint64_t* k_out) {
+    return is_value(e)
+        && !e->value.number.signbit
+        && bni_is_base_power(&e->value.number, k_out)
+        && *k_out <= UINT32_MAX;
+}
+
+static bool is_small_value(const Expr* e, uint64_t v) {
+    uint64_t x;
+    return is_value(e)
+        && !e->value.number.signbit
+        && bni_to_u64(&e->value.number, &x)
+        && x == v;
+}
+
+// evaluate a node whose operands are all values
+static Expr* fold(Expr* e) {
+    if (e->type == X_VALUE) {
+        return e;
+    }
+
+    Program p = compile_expr(e);
+    Expr* v = expr_new();
+    v->type = X_VALUE;
+    v->value = vm_run(&p);
+    program_free(&p);
+    return v;
+}
+
+static Expr* build_shift(Expr* arg, const Expr* scale, uint64_t k, bool right) {
+    Expr* e = expr_new();
+    e->type = X_SHIFT;
+    e->shift.arg = arg;
+    e->shift.scale = scale->value;
+    e->shift.k = k;
+    e->shift.right = right;
+    return e;
+}
+
+// rewrites that drop or replace operands after the first one
+// only valid when the result base comes from the first operand
+static Expr* simplify(Expr* e) {
+    if (BN_CONFIG.base_coercion_mode != BC_BCM_FIRST) {
+        return e;
+    }
+
+    uint64_t k;
+
+    if (e->type == X_UNOP && e->unop.data->name == '+') {
+        // +x => x
+        return e->unop.arg;
+
+    } else if (e->type == X_PRODUCT) {
+        // x * 1 => x, x * 1000 => Shift{<<, x, 3}
+        Product* p = &e->product;
+        Expr** shifts = apc_malloc(p->n_factors * sizeof(Expr*));
+        uint64_t* ks = apc_malloc(p->n_factors * sizeof(uint64_t));
+        size_t n_shifts = 0;
+        size_t n = 1;
+        for (size_t i = 1; i < p->n_factors; i++) {
+            if (is_base_power(p->factors[i], &k)) {
+                shifts[n_shifts] = p->factors[i];
+                ks[n_shifts] = k;
+                n_shifts += 1;
+            } else {
+                p->factors[n] = p->factors[i];
+                n += 1;
+            }
+        }
+        p->n_factors = n;
+
+        Expr* result = (n == 1) ? p->factors[0] : e;
+        for (size_t i = 0; i < n_shifts; i++) {
+            if (ks[i] > 0) {
+                result = build_shift(result, shifts[i], ks[i], false);
+            }
+        }
+        apc_free(shifts);
+        apc_free(ks);
+        return result;
+
+    } else if (e->type == X_SUM) {
+        // x + 0 => x
+        Sum* s = &e->sum;
+        size_t n = 1;
+        for (size_t i = 1; i < s->n_terms; i++) {
+            if (!is_small_value(s->terms[i], 0)) {
+                s->terms[n] = s->terms[i];
+                s->negate[n] = s->negate[i];
+                n += 1;
+            }
+        }
+        s->n_terms = n;
+        return (n == 1) ? s->terms[0] : e;
+
+    } else if (e->type == X_BINOP && e->binop.data->name == '/') {
+        // x / 1 => x, x / 1000 => Shift{>>, x, 3}
+        if (is_small_value(e->binop.arg1, 1)) {
+            return e->binop.arg0;
+        }
+        if (is_base_power(e->binop.arg1, &k)) {
+            return build_shift(e->binop.arg0, e->binop.arg1, k, true);
+        }
+
+    } else if (e->type == X_BINOP && e->binop.data->name == '^') {
+        // x ^ 1 => x
+        if (is_small_value(e->binop.arg1, 1)) {
+            return e->binop.arg0;
+        }
+    }
+
+    return e;
+}
+
+// cost estimates - only used to pick what's worth running on another thread,
+// so they're rough guesses in limb operations that saturate instead of
+// overflowing
+
+static uint64_t cost_add(uint64_t a, uint64_t b) {
+    return (a > UINT64_MAX - b) ? UINT64_MAX : a + b;
+}
+
+static uint64_t cost_mul(uint64_t a, uint64_t b) {
+    return (a != 0 && b > UINT64_MAX / a) ? UINT64_MAX : a * b;
+}
+
+// value of a small literal, 0 if e isn't one
+static uint64_t small_value(const Expr* e) {
+    uint64_t x;
+    return (is_value(e) && bni_to_u64(&e->value.number, &x)) ? x : 0;
+}
+
+// cost of the node itself, given the result sizes (in limbs) of its
+// children, writes the size of its own result to size_out
+static uint64_t estimate_node(const Expr* e, const uint64_t* sizes,
+                              uint64_t* size_out)
+{
+    uint64_t total = 0;
+    uint64_t largest = 0;
+    for (size_t i = 0; i < expr_n_children(e); i++) {
+        total = cost_add(total, sizes[i]);
+        largest = (sizes[i] > largest) ? sizes[i] : largest;
+    }
+
+    uint64_t size = total;
+    uint64_t cost = total;
+
+    switch (e->type) {
+    case X_VALUE:
+        size = bni_real_len(&e->value.number);
+        cost = 0;
+        break;
+    case X_UNOP:
+        break;
+    case X_BINOP:
+        switch (e->binop.data->name) {
+        case '+':
+        case '-':
+            size = largest + 1;
+            break;
+        case '*':
+            cost = cost_mul(sizes[0], sizes[1]);
+            break;
+        case '/':
+        case '%':
+            size = sizes[0];
+            cost = cost_mul(sizes[0], sizes[1]);
+            break;
+        case '^': {
+            // unknown exponents are guessed to be small
+            uint64_t x = small_value(e->binop.arg1);
+            size = cost_mul(sizes[0], (x > 0) ? x : 1);
+            cost = cost_mul(size, size);
+            break;
+        }
+        case '#':
+            size = sizes[0];
+            cost = cost_mul(size, size);
+            break;
+        }
+        break;
+    case X_FUNC:
+        // fact(n), fib(n), pi(n) ... grow with the value of their argument
+        size = cost_add(total, small_value(e->func.args[0]) / 32);
+        cost = cost_mul(size, size);
+        break;
+    case X_PRODUCT:
+        cost = cost_mul(total, total);
+        break;
+    case X_SUM:
+        size = largest + 1;
+        break;
+    case X_SHIFT:
+        size = cost_add(total,
+            e->shift.k / BN_BASE[e->shift.scale.number.base].width);
+        cost = size;
+        break;
+    case X_VAR:
+        size = bni_real_len(&runtime.symbols.vars[e->var.index].value.number);
+        cost = 0;
+        break;
+    }
+
+    *size_out = size;
+    return cost;
+}
+
+typedef struct {
+    Expr* e;
+    size_t next;
+} EstimateFrame;
+
+// sets e->cost and e->reads_var for every node in e, postorder with an
+// explicit stack
+// the result sizes of finished children wait on a second stack, and whether
+// they read a variable on a third
+static void estimate_costs(Expr* e) {
+
+    EstimateFrame* stack = apc_malloc(16 * sizeof(EstimateFrame));
+    size_t capacity = 16;
+    size_t n = 1;
+    stack[0] = (EstimateFrame){ e, 0 };
+
+    uint64_t* sizes = apc_malloc(16 * sizeof(uint64_t));
+    bool* reads_var = apc_malloc(16 * sizeof(bool));
+    size_t sizes_capacity = 16;
+    size_t n_sizes = 0;
+
+    while (n > 0) {
+        EstimateFrame* f = &stack[n - 1];
+        size_t n_children = expr_n_children(f->e);
+
+        if (f->next == n_children) {
+            n_sizes -= n_children;
+            uint64_t size;
+            uint64_t cost = estimate_node(f->e, &sizes[n_sizes], &size);
+            bool var = f->e->type == X_VAR;
+            for (size_t i = 0; i < n_children; i++) {
+                cost = cost_add(cost, (*expr_child(f->e, i))->cost);
+                var = var || reads_var[n_sizes + i];
+            }
+            f->e->cost = cost;
+            f->e->reads_var = var;
+
+            if (n_sizes == sizes_capacity) {
+                sizes_capacity *= 2;
+                sizes = apc_realloc(sizes, sizes_capacity * sizeof(uint64_t));
+                reads_var = apc_realloc(reads_var,
+                    sizes_capacity * sizeof(bool));
+            }
+            sizes[n_sizes] = size;
+            reads_var[n_sizes] = var;
+            n_sizes += 1;
+            n -= 1;
+            continue;
+        }
+
+        EstimateFrame child = { *expr_child(f->e, f->next), 0 };
+        f->next += 1;
+
+        if (n == capacity) {
+            capacity *= 2;
+            stack = apc_realloc(stack, capacity * sizeof(EstimateFrame));
+        }
+        stack[n] = child;
+        n += 1;
+    }
+
+    apc_free(stack);
+    apc_free(sizes);
+    apc_free(reads_var);
+}
+
+// a child subtree being optimized on another thread
+typedef struct {
+    Task task;
+    Expr** slot;
+    size_t index;   // which child it is
+    bool in_mod;
+    bool is_const;
+} OptimizeJob;
+
+// one node being optimized
+typedef struct {
+    Expr* e;
+    Expr** out;     // where the optimized node goes
+    bool in_mod;    // e is part of the expression of a mod(), leave it as is
+    bool is_const;  // no child so far has a free variable
+    size_t next;    // next child to optimize
+
+    // children handed to the pool, in order, joined before the node itself
+    OptimizeJob* jobs;
+    size_t n_jobs;
+    size_t next_job;
+} OptimizeFrame;
+
+static bool is_mod_call(const Expr* e) {
+    return e->type == X_FUNC && e->func.data->fn == FuncFn_Mod;
+}
+
+// the node itself, after all of its children
+static Expr* optimize_node(Expr* e, bool in_mod, bool is_const) {
+
+    if (is_mod_call(e)) {
+        // a mod() result doesn't depend on an enclosing mod()
+        return is_const ? fold(e) : e;
+    }
+
+    if (in_mod) {
+        return e;
+    }
+
+    // (x # a) # b => x # b, if a is a valid base
+    if (e->type == X_BINOP && e->binop.data->name == '#') {
+        Expr* a0 = e->binop.arg0;
+        uint64_t b;
+        if (a0->type == X_BINOP
+        && a0->binop.data->name == '#'
+        && is_value(a0->binop.arg1)
+        && bni_to_u64(&a0->binop.arg1->value.number, &b)
+        && bnu_base_valid(b)) {
+            e->binop.arg0 = a0->binop.arg0;
+        }
+    }
+
+    e = simplify(e);
+
+    // operands are values by now, unless something below isn't constant
+    return is_const ? fold(e) : e;
+}
+
+static Expr* optimize_walk(Expr* e, bool in_mod, bool* is_const_out);
+
+static void optimize_job(void* arg) {
+    OptimizeJob* job = arg;
+    *job->slot = optimize_walk(*job->slot, job->in_mod, &job->is_const);
+}
+
+// worth folding on a thread of its own - a subtree that reads a variable
+// isn't folded at all, it's split when it runs, see compile_expr()
+static bool is_heavy(const Expr* e) {
+    return e->cost >= SPAWN_COST_THRESHOLD && !e->reads_var;
+}
+
+// if two or more children are expensive, all but the first of those go to
+// the pool and the rest are walked on this thread as usual
+// nothing is evaluated inside a mod() expression, so those never split
+static void optimize_spawn_children(OptimizeFrame* f) {
+    if (f->in_mod || is_mod_call(f->e)) {
+        return;
+    }
+
+    size_t n_children = expr_n_children(f->e);
+    size_t n_heavy = 0;
+    for (size_t i = 0; i < n_children; i++) {
+        if (is_heavy(*expr_child(f->e, i))) {
+            n_heavy += 1;
+        }
+    }
+    if (n_heavy < 2) {
+        return;
+    }
+
+    f->jobs = apc_malloc((n_heavy - 1) * sizeof(OptimizeJob));
+    bool first = true;
+    for (size_t i = 0; i < n_children; i++) {
+        if (!is_heavy(*expr_child(f->e, i))) {
+            continue;
+        }
+        if (first) {
+            first = false;
+            continue;
+        }
+        f->jobs[f->n_jobs] = (OptimizeJob){
+            .slot = expr_child(f->e, i),
+            .index = i,
+            .in_mod = f->in_mod
+        };
+        f->n_jobs += 1;
+    }
+
+    // the array is complete before anything can run
+    for (size_t i = 0; i < f->n_jobs; i++) {
+        pool_spawn(&f->jobs[i].task, optimize_job, &f->jobs[i]);
+    }
+}
+
+static void optimize_join_children(OptimizeFrame* f) {
+    for (size_t i = f->n_jobs; i > 0; i--) {
+        pool_join(&f->jobs[i - 1].task);
+        f->is_const = f->is_const && f->jobs[i - 1].is_const;
+    }
+    apc_free(f->jobs);
+    f->jobs = NULL;
+}
+
+// postorder walk with an explicit stack, so the depth of e only costs heap
+static Expr* optimize_walk(Expr* e, bool in_mod, bool* is_const_out) {
+
+    Expr* root = e;
+
+    OptimizeFrame* stack = apc_malloc(16 * sizeof(OptimizeFrame));
+    size_t capacity = 16;
+    size_t n = 1;
+    stack[0] = (OptimizeFrame){ .e = e, .out = &root, .in_mod = in_mod,
+                                .is_const = true };
+
+    while (n > 0) {
+        OptimizeFrame* f = &stack[n - 1];
+
+        if (f->next == expr_n_children(f->e)) {
+            if (f->jobs != NULL) {
+                optimize_join_children(f);
+            }
+            // a variable is read when the program runs
+            bool is_const = f->is_const && f->e->type != X_VAR;
+            *f->out = optimize_node(f->e, f->in_mod, is_const);
+            n -= 1;
+            if (n > 0) {
+                stack[n - 1].is_const = stack[n - 1].is_const && is_const;
+            } else {
+                *is_const_out = is_const;
+            }
+            continue;
+        }
+
+        if (f->next == 0) {
+            optimize_spawn_children(f);
+        }
+
+        // skip the children that went to the pool
+        if (f->next_job < f->n_jobs && f->jobs[f->next_job].index == f->next) {
+            f->next_job += 1;
+            f->next += 1;
+            continue;
+        }
+
+        // the modulus of a mod() is evaluated outside of any, its
+        // expression is inside this one
+        bool in_mod = f->in_mod;
+        if (is_mod_call(f->e)) {
+            in_mod = (f->next == 1);
+        }
+
+        OptimizeFrame child = {
+            .e = *expr_child(f->e, f->next),
+            .out = expr_child(f->e, f->next),
+            .in_mod = in_mod,
+            .is_const = true
+        };
+        f->next += 1;
+
+        if (n == capacity) {
+            capacity *= 2;
+            stack = apc_realloc(stack, capacity * sizeof(OptimizeFrame));
+        }
+        stack[n] = child;
+        n += 1;
+    }
+
+    apc_free(stack);
+    return root;
+}
+
+Expr* optimize_expr(Expr* e) {
+    estimate_costs(e);
+    bool is_const;
+    return optimize_walk(e, false, &is_const);
+}
@@ -0,0 +1,261 @@
+#include "apc.h"
+
+#include <pthread.h>
+
+// one deque per thread - the owner pushes and pops at the tail, the other
+// threads steal from the head, so the oldest (usually biggest) tasks move
+typedef struct {
+    pthread_mutex_t lock;
+    Task** tasks;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} TaskDeque;
+
+typedef struct {
+    TaskDeque* deques;      // deques[0] belongs to the thread that started it
+    size_t n_threads;       // 0 until pool_n_threads() picks one per core
+    bool started;
+
+    // idle workers sleep here until something is pushed, and joiners with
+    // nothing to steal on done_cond until a task finishes or is pushed
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    pthread_cond_t done_cond;
+    atomic_size_t n_queued;
+
+    // spawned and not done yet, queued or running
+    atomic_size_t n_pending;
+
+    // the first error since the last pool_drain(), tasks are skipped while
+    // it's set
+    atomic_int error;
+} Pool;
+
+static Pool pool = {0};
+
+// index of the calling thread's deque
+static _Thread_local size_t pool_self = 0;
+
+static void deque_push(TaskDeque* d, Task* t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->capacity) {
+        d->capacity = d->capacity ? 2 * d->capacity : 16;
+        d->tasks = apc_realloc_persistent(d->tasks,
+            d->capacity * sizeof(Task*));
+    }
+    d->tasks[d->tail] = t;
+    d->tail += 1;
+    pthread_mutex_unlock(&d->lock);
+}
+
+// newest task, or NULL
+static Task* deque_pop(TaskDeque* d) {
+    Task* t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        d->tail -= 1;
+        t = d->tasks[d->tail];
+        if (d->tail == d->head) {
+            d->head = d->tail = 0;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+    return t;
+}
+
+// oldest task, or NULL
+static Task* deque_steal(TaskDeque* d) {
+    Task* t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        t = d->tasks[d->head];
+        d->head += 1;
+        if (d->tail == d->head) {
+            d->head = d->tail = 0;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+    return t;
+}
+
+// own deque first, then the others starting from the next thread over
+static Task* pool_take() {
+    for (size_t i = 0; i < pool.n_threads; i++) {
+        size_t victim = (pool_self + i) % pool.n_threads;
+        Task* t = (i == 0)
+            ? deque_pop(&pool.deques[victim])
+            : deque_steal(&pool.deques[victim]);
+        if (t != NULL) {
+            atomic_fetch_sub(&pool.n_queued, 1);
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// runs t under its own error handler, so an error inside ends up in t
+static void pool_run(Task* t) {
+    jmp_buf handler;
+    jmp_buf* outer = apc_handler;
+    apc_handler = &handler;
+
+    if (setjmp(handler) == 0) {
+        if (atomic_load(&pool.error) == E_OK) {
+            t->fn(t->arg);
+        }
+    } else {
+        int none = E_OK;
+        atomic_compare_exchange_strong(&pool.error, &none, apc_error);
+    }
+
+    apc_handler = outer;
+    t->error = atomic_load(&pool.error);
+    atomic_store(&t->done, true);
+    atomic_fetch_sub(&pool.n_pending, 1);
+
+    pthread_mutex_lock(&pool.idle_lock);
+    pthread_cond_broadcast(&pool.done_cond);
+    pthread_mutex_unlock(&pool.idle_lock);
+}
+
+// until t is done (or with t NULL, every pending task), running whatever
+// can be taken in the meantime and sleeping when there's nothing to take
+static void pool_wait(Task* t) {
+    while (t != NULL ? !atomic_load(&t->done)
+                     : atomic_load(&pool.n_pending) > 0) {
+        Task* other = pool_take();
+        if (other != NULL) {
+            pool_run(other);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool.idle_lock);
+        while (atomic_load(&pool.n_queued) == 0
+        && (t != NULL ? !atomic_load(&t->done)
+                      : atomic_load(&pool.n_pending) > 0)) {
+            pthread_cond_wait(&pool.done_cond, &pool.idle_lock);
+        }
+        pthread_mutex_unlock(&pool.idle_lock);
+    }
+}
+
+static void* pool_worker(void* arg) {
+    pool_self = (size_t)arg;
+
+    while (true) {
+        Task* t = pool_take();
+        if (t != NULL) {
+            pool_run(t);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool.idle_lock);
+        while (atomic_load(&pool.n_queued) == 0) {
+            pthread_cond_wait(&pool.idle_cond, &pool.idle_lock);
+        }
+        pthread_mutex_unlock(&pool.idle_lock);
+    }
+
+    return NULL;
+}
+
+// started by the first pool_spawn(), then lives as long as the process
+// the workers are never joined or torn down, they wait for the next line
+static void pool_init() {
+    pool_n_threads();
+    pool.started = true;
+    pool.deques = apc_malloc_persistent(pool.n_threads * sizeof(TaskDeque));
+
+    pthread_mutex_init(&pool.idle_lock, NULL);
+    pthread_cond_init(&pool.idle_cond, NULL);
+    pthread_cond_init(&pool.done_cond, NULL);
+    atomic_init(&pool.n_queued, 0);
+    atomic_init(&pool.n_pending, 0);
+    atomic_init(&pool.error, E_OK);
+
+    for (size_t i = 0; i < pool.n_threads; i++) {
+        pool.deques[i] = (TaskDeque){0};
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+    }
+
+    for (size_t i = 1; i < pool.n_threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, pool_worker, (void*)i) != 0) {
+            apc_return(E_PROCESS_ERROR);
+        }
+        pthread_detach(thread);
+    }
+}
+
+void pool_set_n_threads(size_t n) {
+    pool.n_threads = n;
+}
+
+size_t pool_n_threads() {
+    if (pool.n_threads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        pool.n_threads = (n > 1) ? (size_t)n : 1;
+    }
+    return pool.n_threads;
+}
+
+void pool_spawn(Task* t, TaskFn fn, void* arg) {
+    t->fn = fn;
+    t->arg = arg;
+    t->error = E_OK;
+    atomic_init(&t->done, false);
+
+    if (!pool.started) {
+        pool_init();
+    }
+    atomic_fetch_add(&pool.n_pending, 1);
+
+    // nobody to hand it to
+    if (pool.n_threads == 1) {
+        pool_run(t);
+        return;
+    }
+
+    deque_push(&pool.deques[pool_self], t);
+    atomic_fetch_add(&pool.n_queued, 1);
+
+    pthread_mutex_lock(&pool.idle_lock);
+    pthread_cond_signal(&pool.idle_cond);
+    pthread_cond_broadcast(&pool.done_cond);
+    pthread_mutex_unlock(&pool.idle_lock);
+}
+
+void pool_join(Task* t) {
+    // if t wasn't stolen it's the newest task on our deque by now, so it
+    // runs right here, otherwise help out with whatever else is queued
+    pool_wait(t);
+
+    if (t->error != E_OK) {
+        apc_return(t->error);
+    }
+}
+
+void pool_drain(ErrorCode error) {
+    if (!pool.started) {
+        return;
+    }
+
+    int none = E_OK;
+    atomic_compare_exchange_strong(&pool.error, &none, error);
+
+    pool_wait(NULL);
+
+    atomic_store(&pool.error, E_OK);
+}
+
+void* pool_spawn_hook(TaskFn fn, void* arg) {
+    Task* t = apc_malloc(sizeof(Task));
+    pool_spawn(t, fn, arg);
+    return t;
+}
+
+void pool_join_hook(void* handle) {
+    pool_join(handle);
+    apc_free(handle);
+}
@@ -0,0 +1,315 @@
+#include "apc.h"
+
+// fnv-1a
+static uint64_t symtab_hash(stringview name) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < name.len; i++) {
+        h ^= (unsigned char)name.str[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// the slot that holds name, or the empty slot where it would go
+static size_t symtab_probe(const SymbolTable* st, stringview name) {
+    size_t mask = st->n_slots - 1;
+    size_t i = symtab_hash(name) & mask;
+    while (st->slots[i] != 0) {
+        const char* other = st->vars[st->slots[i] - 1].name;
+        if (strlen(other) == name.len && !memcmp(other, name.str, name.len)) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// double the slots and put every variable back
+static void symtab_grow(SymbolTable* st) {
+    apc_free_persistent(st->slots);
+    st->n_slots = st->n_slots ? 2 * st->n_slots : 16;
+    st->slots = apc_malloc_persistent(st->n_slots * sizeof(size_t));
+    memset(st->slots, 0, st->n_slots * sizeof(size_t));
+
+    for (size_t i = 0; i < st->n_vars; i++) {
+        size_t slot = symtab_probe(st, sv_from(st->vars[i].name));
+        st->slots[slot] = i + 1;
+    }
+}
+
+int64_t symtab_find(const SymbolTable* st, stringview name) {
+    if (st->n_slots == 0) {
+        return -1;
+    }
+    size_t slot = symtab_probe(st, name);
+    return (int64_t)st->slots[slot] - 1;
+}
+
+size_t symtab_intern(SymbolTable* st, stringview name) {
+    int64_t found = symtab_find(st, name);
+    if (found >= 0) {
+        return found;
+    }
+
+    // keep the load factor under 3/4
+    if (4 * (st->n_vars + 1) > 3 * st->n_slots) {
+        symtab_grow(st);
+    }
+
+    if (st->n_vars == st->vars_capacity) {
+        st->vars_capacity = st->vars_capacity ? 2 * st->vars_capacity : 16;
+        st->vars = apc_realloc_persistent(st->vars,
+            st->vars_capacity * sizeof(Variable));
+    }
+
+    char* copy = apc_malloc_persistent(name.len + 1);
+    memcpy(copy, name.str, name.len);
+    copy[name.len] = '\0';
+
+    size_t i = st->n_vars;
+    st->vars[i] = (Variable){ .name = copy };
+    st->n_vars += 1;
+
+    st->slots[symtab_probe(st, name)] = i + 1;
+    return i;
+}
+
+bool symtab_assign(SymbolTable* st, size_t i, const Value* v) {
+    Variable* var = &st->vars[i];
+    const Bignum* src = &v->number;
+    Bignum* dst = &var->value.number;
+    size_t len = bni_real_len(src);
+    size_t old_len = var->defined ? bni_real_len(dst) : 0;
+
+    // same digits in the same base - a different base prints differently,
+    // so that counts as a change
+    // a result written over the variable's own digits left nothing to
+    // compare with, so that's a change too
+    bool in_place = src->digits_end == dst->digits_end;
+    if (!in_place && old_len == len && var->value.type == v->type
+        && dst->base == src->base && dst->signbit == src->signbit
+        && !memcmp(dst->digits_end, src->digits_end,
+                   len * sizeof(bn_digit_t))) {
+        return false;
+    }
+
+    if (dst->capacity < len) {
+        // half again as much room, so a value that grows a little with
+        // every assignment doesn't move every time
+        size_t capacity = bnu_max(len, dst->capacity + dst->capacity / 2);
+        dst->digits_end = apc_realloc_persistent(dst->digits_end,
+            capacity * sizeof(bn_digit_t));
+        memset(dst->digits_end + dst->capacity, 0,
+            (capacity - dst->capacity) * sizeof(bn_digit_t));
+        dst->capacity = capacity;
+    }
+
+    // x = x reads straight from the same digits
+    memmove(dst->digits_end, src->digits_end, len * sizeof(bn_digit_t));
+    if (old_len > len) {
+        memset(dst->digits_end + len, 0, (old_len - len) * sizeof(bn_digit_t));
+    }
+
+    dst->msd_pos = len - 1;
+    dst->base = src->base;
+    dst->signbit = src->signbit;
+    var->value.type = v->type;
+    var->defined = true;
+    return true;
+}
+
+static void symtab_add_user(SymbolTable* st, size_t i, size_t user) {
+    Variable* var = &st->vars[i];
+    if (var->n_users == var->users_capacity) {
+        var->users_capacity = var->users_capacity
+            ? 2 * var->users_capacity : 4;
+        var->users = apc_realloc_persistent(var->users,
+            var->users_capacity * sizeof(size_t));
+    }
+    var->users[var->n_users] = user;
+    var->n_users += 1;
+}
+
+static void symtab_remove_user(SymbolTable* st, size_t i, size_t user) {
+    Variable* var = &st->vars[i];
+    for (size_t k = 0; k < var->n_users; k++) {
+        if (var->users[k] == user) {
+            var->n_users -= 1;
+            var->users[k] = var->users[var->n_users];
+            return;
+        }
+    }
+}
+
+// back to a plain value, out of the graph
+static void symtab_forget_def(SymbolTable* st, size_t i) {
+    Variable* var = &st->vars[i];
+    for (size_t k = 0; k < var->n_deps; k++) {
+        symtab_remove_user(st, var->deps[k], i);
+    }
+    program_free_persistent(&var->def);
+    apc_free_persistent(var->deps);
+    apc_free_persistent(var->dep_versions);
+    var->deps = NULL;
+    var->dep_versions = NULL;
+    var->n_deps = 0;
+}
+
+static int symtab_cmp_index(const void* a, const void* b) {
+    size_t x = *(const size_t*)a;
+    size_t y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
+
+// true if vars[i] is one of deps, or something downstream of it is, so
+// defining vars[i] in terms of deps would close a cycle
+static bool symtab_reaches(const SymbolTable* st, size_t i,
+                           const size_t* deps, size_t n_deps) {
+    bool* seen = apc_malloc(st->n_vars * sizeof(bool));
+    memset(seen, 0, st->n_vars * sizeof(bool));
+    size_t* stack = apc_malloc(st->n_vars * sizeof(size_t));
+    size_t n_stack = 0;
+
+    stack[n_stack++] = i;
+    seen[i] = true;
+    bool found = false;
+
+    while (n_stack > 0 && !found) {
+        size_t u = stack[--n_stack];
+        if (bsearch(&u, deps, n_deps, sizeof(size_t), symtab_cmp_index)) {
+            found = true;
+        }
+        const Variable* var = &st->vars[u];
+        for (size_t k = 0; k < var->n_users; k++) {
+            size_t w = var->users[k];
+            if (!seen[w]) {
+                seen[w] = true;
+                stack[n_stack++] = w;
+            }
+        }
+    }
+
+    apc_free(stack);
+    apc_free(seen);
+    return found;
+}
+
+// everything downstream of vars[i] has to be looked at again
+static void symtab_mark_users(SymbolTable* st, size_t i) {
+    size_t* stack = apc_malloc(st->n_vars * sizeof(size_t));
+    size_t n_stack = 0;
+
+    // marked when pushed, so nothing goes on the stack twice - and a
+    // variable that was dirty already had its users marked
+    stack[n_stack++] = i;
+    while (n_stack > 0) {
+        const Variable* var = &st->vars[stack[--n_stack]];
+        for (size_t k = 0; k < var->n_users; k++) {
+            Variable* user = &st->vars[var->users[k]];
+            if (!user->dirty) {
+                user->dirty = true;
+                stack[n_stack++] = var->users[k];
+            }
+        }
+    }
+
+    apc_free(stack);
+}
+
+void symtab_define(SymbolTable* st, size_t i, const Program* def,
+                   const Value* v) {
+    symtab_forget_def(st, i);
+
+    // what def reads, each once
+    size_t n_deps = 0;
+    size_t* deps = apc_malloc((def->n_code + 1) * sizeof(size_t));
+    for (size_t k = 0; k < def->n_code; k++) {
+        if (def->code[k].op == OP_LOAD) {
+            deps[n_deps++] = def->code[k].a;
+        }
+    }
+    qsort(deps, n_deps, sizeof(size_t), symtab_cmp_index);
+    size_t n_unique = 0;
+    for (size_t k = 0; k < n_deps; k++) {
+        if (n_unique == 0 || deps[n_unique - 1] != deps[k]) {
+            deps[n_unique++] = deps[k];
+        }
+    }
+    n_deps = n_unique;
+
+    // constants have nothing to recompute from, and x = x + 1 or a cycle
+    // would never settle, so those stay plain values
+    Variable* var = &st->vars[i];
+    if (n_deps > 0 && !symtab_reaches(st, i, deps, n_deps)) {
+        var->def = program_copy_persistent(def);
+        var->deps = apc_malloc_persistent(n_deps * sizeof(size_t));
+        var->dep_versions = apc_malloc_persistent(n_deps * sizeof(uint64_t));
+        var->n_deps = n_deps;
+        for (size_t k = 0; k < n_deps; k++) {
+            var->deps[k] = deps[k];
+            var->dep_versions[k] = st->vars[deps[k]].version;
+            symtab_add_user(st, deps[k], i);
+        }
+    }
+    apc_free(deps);
+
+    var->dirty = false;
+    if (symtab_assign(st, i, v)) {
+        var->version += 1;
+        symtab_mark_users(st, i);
+    }
+}
+
+typedef struct {
+    size_t index;
+    size_t next_dep;    // deps before this one are up to date
+} RefreshFrame;
+
+void symtab_refresh(SymbolTable* st, size_t i) {
+    if (!st->vars[i].dirty) {
+        return;
+    }
+
+    // post order over the dirty part of the graph, so every definition runs
+    // after the ones it reads
+    RefreshFrame* stack = apc_malloc(st->n_vars * sizeof(RefreshFrame));
+    size_t n_stack = 0;
+    stack[n_stack++] = (RefreshFrame){ .index = i };
+
+    while (n_stack > 0) {
+        RefreshFrame* f = &stack[n_stack - 1];
+        Variable* var = &st->vars[f->index];
+
+        if (f->next_dep < var->n_deps) {
+            size_t dep = var->deps[f->next_dep];
+            f->next_dep += 1;
+            if (st->vars[dep].dirty) {
+                stack[n_stack++] = (RefreshFrame){ .index = dep };
+            }
+            continue;
+        }
+
+        // only rerun it if an input really changed, otherwise the value
+        // it has is still the right one
+        bool stale = false;
+        for (size_t k = 0; k < var->n_deps; k++) {
+            stale |= st->vars[var->deps[k]].version != var->dep_versions[k];
+        }
+
+        if (stale) {
+            // an error in here leaves it dirty, so the next read tries again
+            Value result = vm_run(&var->def);
+            if (symtab_assign(st, f->index, &result)) {
+                var->version += 1;
+            }
+            for (size_t k = 0; k < var->n_deps; k++) {
+                var->dep_versions[k] = st->vars[var->deps[k]].version;
+            }
+        }
+
+        var->dirty = false;
+        n_stack -= 1;
+    }
+
+    apc_free(stack);
+}
@@ -1,14 +1,5 @@
 #include "apc.h"
 
-bool char_in_string(char c, const char* str) {
-    for (const char* s = str; *s != '\0'; s++) {
-        if (*s == c) {
-            return true;
-        }
-    }
-    return false;
-}
-
 bool parens_are_balanced(stringview sv) {
     int64_t count = 0;
     for (size_t i = 0; i < sv.len; i++) {
@@ -30,3 +21,12 @@ void ctrl_c_signal_handler(int s) {
     fputc('\n', stdout);
     apc_exit(0);
 }
+
+void crash_signal_handler(int s) {
+    (void)s;
+    // the crash may have been inside stdio, so write() only
+    static const char msg[] = " = internal error\n";
+    ssize_t n = write(STDOUT_FILENO, msg, sizeof(msg) - 1);
+    (void)n;
+    _exit(E_INTERNAL_ERROR);
+}
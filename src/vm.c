@@ -0,0 +1,734 @@
+#include "apc.h"
+
+// compiler
+
+typedef struct {
+    Program p;
+    size_t code_capacity;
+    size_t consts_capacity;
+} Compiler;
+
+static void compiler_emit(Compiler* c, Instr in) {
+    if (c->p.n_code == c->code_capacity) {
+        c->code_capacity = c->code_capacity ? 2 * c->code_capacity : 16;
+        c->p.code = apc_realloc(c->p.code, c->code_capacity * sizeof(Instr));
+    }
+    c->p.code[c->p.n_code] = in;
+    c->p.n_code += 1;
+}
+
+static uint32_t compiler_add_const(Compiler* c, Value v) {
+    if (c->p.n_consts == c->consts_capacity) {
+        c->consts_capacity = c->consts_capacity ? 2 * c->consts_capacity : 16;
+        c->p.consts = apc_realloc(c->p.consts,
+            c->consts_capacity * sizeof(Value));
+    }
+    c->p.consts[c->p.n_consts] = v;
+    c->p.n_consts += 1;
+    return c->p.n_consts - 1;
+}
+
+// registers [dst, dst + n) are in use
+static void compiler_use_regs(Compiler* c, uint32_t dst, size_t n) {
+    if (dst + n > c->p.n_regs) {
+        c->p.n_regs = dst + n;
+    }
+}
+
+// one node being compiled - its result goes in r[dst], everything above dst
+// is free to use as temporaries, results of +, -, * are reduced in ctx if >= 0
+typedef struct {
+    const Expr* e;
+    uint32_t dst;
+    int32_t ctx;
+    int32_t slot;   // the ModContext of a mod() call
+    size_t next;    // next child to compile
+
+    // children run as jobs - if split, every expensive one before the last,
+    // which runs on this thread in the meantime
+    bool split;
+    size_t last_heavy;
+    uint32_t next_job;  // job slot of the next one
+    size_t spawn_at;    // OP_SPAWN of the one being compiled
+} CompileFrame;
+
+static bool is_mod_call(const Expr* e) {
+    return e->type == X_FUNC && e->func.data->fn == FuncFn_Mod;
+}
+
+// worth a thread of its own, constant subtrees are values by now unless
+// they're part of a mod()
+static bool is_heavy(const Expr* e) {
+    return e->cost >= SPAWN_COST_THRESHOLD;
+}
+
+// split f if two or more children are expensive, nothing that's reduced in
+// a ModContext splits since the jobs don't share it
+static void compile_plan_split(Compiler* c, CompileFrame* f) {
+    if (f->ctx >= 0 || is_mod_call(f->e)) {
+        return;
+    }
+
+    size_t n_heavy = 0;
+    for (size_t i = 0; i < expr_n_children(f->e); i++) {
+        if (is_heavy(*expr_child((Expr*)f->e, i))) {
+            n_heavy += 1;
+            f->last_heavy = i;
+        }
+    }
+    if (n_heavy < 2) {
+        return;
+    }
+
+    f->split = true;
+    f->next_job = c->p.n_jobs;
+    c->p.n_jobs += n_heavy - 1;
+}
+
+static bool compile_is_job(const CompileFrame* f, size_t i) {
+    return f->split && i < f->last_heavy
+        && is_heavy(*expr_child((Expr*)f->e, i));
+}
+
+// joins, newest job first, before the node itself reads the results
+static void compile_joins(Compiler* c, const CompileFrame* f) {
+    uint32_t job = f->next_job;
+    for (size_t i = f->last_heavy; i-- > 0;) {
+        if (!compile_is_job(f, i)) {
+            continue;
+        }
+        job -= 1;
+        uint32_t r = f->dst + i;
+        compiler_emit(c, (Instr){ OP_JOIN, -1, r, job, 0, 0 });
+        if (f->e->type == X_SUM && f->e->sum.negate[i]) {
+            compiler_emit(c, (Instr){ OP_NEG, -1, r, r, 0, 0 });
+        }
+    }
+}
+
+// where child i of f is compiled to
+static void compile_child_target(const CompileFrame* f, size_t i,
+                                 uint32_t* dst, int32_t* ctx)
+{
+    const Expr* e = f->e;
+    *dst = f->dst + i;
+    *ctx = f->ctx;
+
+    if (e->type == X_BINOP && e->binop.data->name == '^' && i == 1) {
+        // the exponent is not a residue, it's compiled outside the context
+        *ctx = -1;
+    } else if (is_mod_call(e)) {
+        // the modulus itself is not reduced by an enclosing mod()
+        *dst = f->dst;
+        *ctx = (i == 0) ? -1 : f->slot;
+    }
+}
+
+// instructions between child i and the next one
+static void compile_after_child(Compiler* c, const CompileFrame* f, size_t i) {
+    const Expr* e = f->e;
+
+    // the job ends here, anything else on its result waits for the join
+    if (compile_is_job(f, i)) {
+        c->p.code[f->spawn_at].b = c->p.n_code;
+        return;
+    }
+
+    if (is_mod_call(e) && i == 0) {
+        compiler_emit(c, (Instr){ OP_MOD_INIT, f->slot, 0, f->dst, 0, 0 });
+    } else if (e->type == X_SUM && e->sum.negate[i]) {
+        uint32_t r = f->dst + i;
+        compiler_emit(c, (Instr){ OP_NEG, -1, r, r, 0, 0 });
+    }
+}
+
+// the instruction for the node itself, after all of its children
+static void compile_node(Compiler* c, const CompileFrame* f) {
+    const Expr* e = f->e;
+    uint32_t dst = f->dst;
+    int32_t ctx = f->ctx;
+
+    if (e->type == X_VALUE) {
+        uint32_t k = compiler_add_const(c, e->value);
+        compiler_emit(c, (Instr){ OP_CONST, -1, dst, k, 0, 0 });
+
+    } else if (e->type == X_UNOP) {
+        OpCode op = (e->unop.data->name == '-') ? OP_NEG : OP_POS;
+        compiler_emit(c, (Instr){ op, ctx, dst, dst, 0, 0 });
+
+    } else if (e->type == X_BINOP) {
+        char name = e->binop.data->name;
+
+        if (name == '^' && ctx >= 0) {
+            compiler_emit(c, (Instr){ OP_POWMOD, ctx, dst, dst, dst + 1, 0 });
+            return;
+        }
+
+        OpCode op = OP_ADD;
+        int32_t reduce_ctx = ctx;
+        switch (name) {
+            case '+': op = OP_ADD; break;
+            case '-': op = OP_SUB; break;
+            case '*': op = OP_MUL; break;
+            case '/': op = OP_DIV; reduce_ctx = -1; break;
+            case '%': op = OP_MOD; reduce_ctx = -1; break;
+            case '^': op = OP_POW; reduce_ctx = -1; break;
+            case '#': op = OP_CONV; reduce_ctx = -1; break;
+            default: apc_return(E_INTERNAL_ERROR);
+        }
+        compiler_emit(c, (Instr){ op, reduce_ctx, dst, dst, dst + 1, 0 });
+
+    } else if (is_mod_call(e)) {
+        compiler_emit(c, (Instr){ OP_MOD_END, f->slot, dst, dst, 0, 0 });
+
+    } else if (e->type == X_FUNC) {
+        uint32_t fn = e->func.data - runtime.func_data;
+        compiler_emit(c, (Instr){ OP_CALL, -1, dst, dst, e->func.n_args, fn });
+
+    } else if (e->type == X_PRODUCT) {
+        compiler_emit(c, (Instr){
+            OP_PRODUCT, ctx, dst, dst, e->product.n_factors, 0
+        });
+
+    } else if (e->type == X_SUM) {
+        compiler_emit(c, (Instr){ OP_SUM, ctx, dst, dst, e->sum.n_terms, 0 });
+
+    } else if (e->type == X_SHIFT) {
+        uint32_t k = compiler_add_const(c, e->shift.scale);
+        OpCode op = e->shift.right ? OP_RSHIFT : OP_LSHIFT;
+        compiler_emit(c, (Instr){ op, -1, dst, dst, k, e->shift.k });
+
+    } else if (e->type == X_VAR) {
+        compiler_emit(c, (Instr){ OP_LOAD, -1, dst, e->var.index, 0, 0 });
+
+    } else {
+        apc_return(E_INTERNAL_ERROR);
+    }
+}
+
+// postorder walk with an explicit stack, so the depth of e only costs heap
+static void compile_into(Compiler* c, const Expr* e, uint32_t dst, int32_t ctx) {
+
+    CompileFrame* stack = apc_malloc(16 * sizeof(CompileFrame));
+    size_t capacity = 16;
+    size_t n = 1;
+    stack[0] = (CompileFrame){ .e = e, .dst = dst, .ctx = ctx, .slot = -1 };
+
+    while (n > 0) {
+        CompileFrame* f = &stack[n - 1];
+        size_t n_children = expr_n_children(f->e);
+
+        if (f->next == 0) {
+            // first visit
+            size_t n_regs = (f->e->type == X_BINOP) ? 2 : n_children;
+            compiler_use_regs(c, f->dst, n_regs > 0 ? n_regs : 1);
+            if (is_mod_call(f->e)) {
+                f->slot = c->p.n_ctx;
+                c->p.n_ctx += 1;
+            }
+            compile_plan_split(c, f);
+        } else {
+            // back from child next - 1
+            compile_after_child(c, f, f->next - 1);
+        }
+
+        if (f->next == n_children) {
+            if (f->split) {
+                compile_joins(c, f);
+            }
+            compile_node(c, f);
+            n -= 1;
+            continue;
+        }
+
+        CompileFrame child = {
+            .e = *expr_child((Expr*)f->e, f->next),
+            .slot = -1
+        };
+        compile_child_target(f, f->next, &child.dst, &child.ctx);
+        if (compile_is_job(f, f->next)) {
+            f->spawn_at = c->p.n_code;
+            compiler_emit(c, (Instr){
+                OP_SPAWN, -1, child.dst, f->next_job, 0, 0
+            });
+            f->next_job += 1;
+        }
+        f->next += 1;
+
+        if (n == capacity) {
+            capacity *= 2;
+            stack = apc_realloc(stack, capacity * sizeof(CompileFrame));
+        }
+        stack[n] = child;
+        n += 1;
+    }
+
+    apc_free(stack);
+}
+
+Program compile_expr(const Expr* e) {
+    Compiler c = {0};
+    compile_into(&c, e, 0, -1);
+    compiler_emit(&c, (Instr){ OP_RET, -1, 0, 0, 0, 0 });
+    return c.p;
+}
+
+// whether in reads r[r]
+static bool instr_reads(const Instr* in, uint32_t r) {
+    switch (in->op) {
+        case OP_CONST: case OP_LOAD: case OP_SPAWN: case OP_JOIN:
+            return false;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_POW: case OP_CONV: case OP_POWMOD:
+            return in->a == r || in->b == r;
+        case OP_PRODUCT: case OP_SUM: case OP_CALL:
+            return r >= in->a && r < in->a + in->b;
+        default:
+            // unops, shifts, mod contexts and ret only read r[a]
+            return in->a == r;
+    }
+}
+
+void compile_write_back(Program* p, size_t var) {
+
+    // a second load would see the digits after they were written over
+    size_t load = p->n_code;
+    for (size_t i = 0; i < p->n_code; i++) {
+        if (p->code[i].op == OP_LOAD && p->code[i].a == var) {
+            if (load != p->n_code) {
+                return;
+            }
+            load = i;
+        }
+    }
+
+    // only the instruction before OP_RET may write over them, nothing runs
+    // after it that could fail and leave the variable half updated
+    size_t last = p->n_code - 2;
+    if (load >= last) {
+        return;
+    }
+
+    uint32_t r = p->code[load].dst;
+    for (size_t i = load + 1; i < last; i++) {
+        if (p->code[i].dst == r || instr_reads(&p->code[i], r)) {
+            return;
+        }
+    }
+    if (!instr_reads(&p->code[last], r)) {
+        return;
+    }
+
+    p->code[load].b = 1;
+}
+
+void program_free(Program* p) {
+    apc_free(p->code);
+    apc_free(p->consts);
+    *p = (Program){0};
+}
+
+Program program_copy_persistent(const Program* p) {
+    Program c = *p;
+
+    c.code = apc_malloc_persistent(p->n_code * sizeof(Instr));
+    memcpy(c.code, p->code, p->n_code * sizeof(Instr));
+
+    // +1 so it's never a 0 byte allocation
+    c.consts = apc_malloc_persistent((p->n_consts + 1) * sizeof(Value));
+    for (size_t i = 0; i < p->n_consts; i++) {
+        c.consts[i] = value_copy_persistent(&p->consts[i]);
+    }
+
+    return c;
+}
+
+void program_free_persistent(Program* p) {
+    for (size_t i = 0; i < p->n_consts; i++) {
+        value_free_persistent(&p->consts[i]);
+    }
+    apc_free_persistent(p->consts);
+    apc_free_persistent(p->code);
+    *p = (Program){0};
+}
+
+Value value_copy_persistent(const Value* v) {
+    const Bignum* src = &v->number;
+    size_t len = bni_real_len(src);
+
+    Bignum b = *src;
+    b.digits_end = apc_malloc_persistent(len * sizeof(bn_digit_t));
+    memcpy(b.digits_end, src->digits_end, len * sizeof(bn_digit_t));
+    b.capacity = len;
+    b.borrowed = 0;
+
+    return (Value){ .type = v->type, .number = b };
+}
+
+void value_free_persistent(Value* v) {
+    apc_free_persistent(v->number.digits_end);
+    *v = (Value){0};
+}
+
+// vm
+
+static Bignum* vm_number(Value* v) {
+    if (v->type != V_NUMBER) {
+        apc_return(E_VALUE_ERROR);
+    }
+    return &v->number;
+}
+
+static Value vm_reduce(const ModContext* ctx, Value v) {
+    Value result = { .type = V_NUMBER };
+    bn_barrett_reduce(&result.number, &ctx->barrett, vm_number(&v));
+    return result;
+}
+
+static int vm_len_cmp(const void* a, const void* b) {
+    size_t la = bni_real_len(&((const Value*)a)->number);
+    size_t lb = bni_real_len(&((const Value*)b)->number);
+    return (la > lb) - (la < lb);
+}
+
+// r[0] * ... * r[n - 1] - converts all factors to the base a left to right
+// chain would end up in, then multiplies neighbors after sorting by size,
+// halving the list each round, so both sides are about the same size
+// clobbers r[0..n)
+static Value vm_product(Value* r, size_t n, const ModContext* ctx) {
+
+    // x * 3 goes through * so it can be written over x if x is owned
+    if (n == 2 && ctx == NULL) {
+        return BinopFn_Mul(r[0], r[1]);
+    }
+
+    Bignum* b = apc_malloc(n * sizeof(Bignum));
+    for (size_t i = 0; i < n; i++) {
+        b[i] = *vm_number(&r[i]);
+    }
+    bn_base_t base = bni_bcm_base(b, n);
+    apc_free(b);
+
+    for (size_t i = 0; i < n; i++) {
+        if (r[i].number.base != base) {
+            Value c = { .type = V_NUMBER };
+            bn_convert(&c.number, &r[i].number, base);
+            r[i] = c;
+        }
+    }
+
+    while (n > 1) {
+        qsort(r, n, sizeof(Value), vm_len_cmp);
+        for (size_t i = 0; i < n / 2; i++) {
+            Value v = { .type = V_NUMBER };
+            bn_mul(&v.number, &r[2 * i].number, &r[2 * i + 1].number);
+            r[i] = (ctx != NULL) ? vm_reduce(ctx, v) : v;
+        }
+        if (n % 2 == 1) {
+            r[n / 2] = r[n - 1];
+        }
+        n = (n + 1) / 2;
+    }
+
+    return r[0];
+}
+
+// r[0] + ... + r[n - 1]
+static Value vm_sum(Value* r, size_t n) {
+
+    // same for x + 1
+    if (n == 2) {
+        return BinopFn_Add(r[0], r[1]);
+    }
+
+    Bignum* b = apc_malloc(n * sizeof(Bignum));
+    for (size_t i = 0; i < n; i++) {
+        b[i] = *vm_number(&r[i]);
+    }
+
+    Value result = { .type = V_NUMBER };
+    bn_sum(&result.number, b, n);
+    apc_free(b);
+    return result;
+}
+
+// a0 ^ a1 inside a ModContext - powmod with the cached reducers
+static Value vm_powmod(Value a0, Value a1, const ModContext* ctx) {
+    Value v0 = vm_reduce(ctx, a0);
+    Bignum* e = vm_number(&a1);
+
+    // negative exponent => not an integer
+    if (e->signbit && !bn_equals_zero(e)) {
+        apc_return(E_VALUE_ERROR);
+    }
+
+    Value result = { .type = V_NUMBER };
+
+    if (ctx->has_mont
+    && v0.number.base == ctx->mont.m.base
+    && !bn_equals_zero(e)) {
+        bni_mont_powmod(&result.number, &ctx->mont, &v0.number, e);
+    } else {
+        bn_powmod(&result.number, &v0.number, e, &ctx->barrett.m);
+    }
+
+    return result;
+}
+
+// the memo key of an operation that can take long, if in is one
+// inside a mod() the operands are already reduced, so those are always cheap
+static bool vm_memo_key(const Instr* in, const Value* r, MemoKey* key) {
+    if (in->ctx >= 0) {
+        return false;
+    }
+
+    size_t n_args = 2;
+    bool always = false;    // even small operands can make a big result
+    switch (in->op) {
+        case OP_MUL: case OP_DIV: case OP_MOD: case OP_CONV:
+            break;
+        case OP_POW:
+            always = true;
+            break;
+        case OP_CALL:
+            n_args = in->b;
+            always = true;
+            break;
+        default:
+            return false;
+    }
+
+    // binops read r[a] and r[a + 1]
+    if (in->op != OP_CALL && in->b != in->a + 1) {
+        return false;
+    }
+
+    size_t len = 0;
+    for (size_t i = 0; i < n_args; i++) {
+        if (r[in->a + i].type != V_NUMBER) {
+            return false;
+        }
+        size_t n = bni_real_len(&r[in->a + i].number);
+
+        // a single digit operand makes it one pass over the other one, which
+        // is no slower than hashing it
+        if (n == 1 && !always && in->op != OP_CONV) {
+            return false;
+        }
+        len += n;
+    }
+    if (!always && len < MEMO_MIN_LEN) {
+        return false;
+    }
+
+    // x # b in x's own base passes x through, there's nothing to remember
+    const Bignum* base = &r[in->a + 1].number;
+    if (in->op == OP_CONV && bni_real_len(base) == 1
+    && base->digits_end[0] == r[in->a].number.base) {
+        return false;
+    }
+
+    uint64_t fn = (in->op == OP_CALL) ? in->c : 0;
+    *key = (MemoKey){
+        .tag = ((uint64_t)in->op << 32) | fn,
+        .args = &r[in->a],
+        .n_args = n_args
+    };
+    return true;
+}
+
+// the code between an OP_SPAWN and code[b], run on the pool with registers
+// of its own - it only reads registers it wrote itself
+typedef struct VmJob {
+    Task task;
+    const Program* p;
+    const Instr* start;
+    const Instr* end;
+    uint32_t dst;
+    struct VmJob* jobs;     // the slots of the whole run, for nested spawns
+    Value result;
+} VmJob;
+
+static Value vm_exec(const Program* p, const Instr* in, const Instr* end,
+                     uint32_t dst, VmJob* jobs);
+
+static void vm_job(void* arg) {
+    VmJob* job = arg;
+    job->result = vm_exec(job->p, job->start, job->end, job->dst, job->jobs);
+}
+
+Value vm_run(const Program* p) {
+    // +1 so it's never a 0 byte allocation
+    VmJob* jobs = apc_malloc((p->n_jobs + 1) * sizeof(VmJob));
+    Value v = vm_exec(p, p->code, NULL, 0, jobs);
+    apc_free(jobs);
+    return v;
+}
+
+// run from in up to OP_RET, or up to end and return r[dst]
+static Value vm_exec(const Program* p, const Instr* in, const Instr* end,
+                     uint32_t dst, VmJob* jobs)
+{
+    // +1 so neither is ever a 0 byte allocation
+    Value* r = apc_malloc((p->n_regs + 1) * sizeof(Value));
+    ModContext* ctxs = apc_malloc((p->n_ctx + 1) * sizeof(ModContext));
+
+    for (; ; in++) {
+
+        if (in == end) {
+            Value v = r[dst];
+            apc_free(r);
+            apc_free(ctxs);
+            return v;
+        }
+
+        // registers (and constants) can share digits, so operands are only
+        // read - except an owned register, which is a result nothing else
+        // points at, whose parent can write over it since it's never read again
+        Value v = { .type = V_NUMBER };
+
+        MemoKey key;
+        bool memo = vm_memo_key(in, r, &key);
+        if (memo && memo_find(&key, &v)) {
+            v.owned = true;
+            r[in->dst] = v;
+            continue;
+        }
+
+        switch (in->op) {
+        case OP_CONST:
+            r[in->dst] = p->consts[in->a];
+            r[in->dst].owned = false;
+            continue;
+        case OP_LOAD:
+            // variables keep their own digits, b marks the last read of them
+            // on a line that writes its result back to the same variable
+            r[in->dst] = runtime.symbols.vars[in->a].value;
+            r[in->dst].owned = in->b;
+            continue;
+        case OP_POS:
+            // same digits, so it's owned if the operand was
+            vm_number(&r[in->a]);
+            v = r[in->a];
+            break;
+        case OP_NEG:
+            vm_number(&r[in->a]);
+            v = r[in->a];
+            v.number.signbit = bn_equals_zero(&v.number)
+                ? 0 : !v.number.signbit;
+            break;
+        case OP_ADD:
+            v = BinopFn_Add(r[in->a], r[in->b]);
+            break;
+        case OP_SUB:
+            v = BinopFn_Sub(r[in->a], r[in->b]);
+            break;
+        case OP_MUL:
+            v = BinopFn_Mul(r[in->a], r[in->b]);
+            break;
+        case OP_DIV:
+            v = BinopFn_Div(r[in->a], r[in->b]);
+            break;
+        case OP_MOD:
+            v = BinopFn_Mod(r[in->a], r[in->b]);
+            break;
+        case OP_POW:
+            v = BinopFn_Pow(r[in->a], r[in->b]);
+            break;
+        case OP_CONV:
+            v = BinopFn_BaseConv(r[in->a], r[in->b]);
+            break;
+        case OP_LSHIFT:
+            if (vm_number(&r[in->a])->base != p->consts[in->b].number.base) {
+                bn_mul(&v.number, &r[in->a].number, &p->consts[in->b].number);
+                break;
+            }
+            bni_mul_base_power(&v.number, &r[in->a].number, in->c);
+            break;
+        case OP_RSHIFT:
+            if (vm_number(&r[in->a])->base != p->consts[in->b].number.base
+            || r[in->a].number.signbit) {
+                v = BinopFn_Div(r[in->a], p->consts[in->b]);
+                break;
+            }
+            bni_div_base_power(&v.number, &r[in->a].number, in->c);
+            break;
+        case OP_POWMOD:
+            r[in->dst] = vm_powmod(r[in->a], r[in->b], &ctxs[in->ctx]);
+            r[in->dst].owned = true;
+            continue;
+        case OP_PRODUCT:
+            r[in->dst] = vm_product(&r[in->a], in->b,
+                (in->ctx >= 0) ? &ctxs[in->ctx] : NULL);
+            r[in->dst].owned = true;
+            continue;
+        case OP_SUM:
+            v = vm_sum(&r[in->a], in->b);
+            break;
+        case OP_CALL:
+            v = runtime.func_data[in->c].fn((FuncArgs){
+                .args = &r[in->a],
+                .n_args = in->b
+            });
+            break;
+        case OP_MOD_INIT: {
+            ModContext* ctx = &ctxs[in->ctx];
+            if (!bn_barrett_init(&ctx->barrett, vm_number(&r[in->a]))) {
+                // m <= 0
+                apc_return(E_VALUE_ERROR);
+            }
+            ctx->has_mont = bn_mont_init(&ctx->mont, &r[in->a].number);
+            continue;
+        }
+        case OP_MOD_END: {
+            ModContext* ctx = &ctxs[in->ctx];
+            r[in->dst] = vm_reduce(ctx, r[in->a]);
+            r[in->dst].owned = true;
+            bn_barrett_free(&ctx->barrett);
+            if (ctx->has_mont) {
+                bn_mont_free(&ctx->mont);
+            }
+            continue;
+        }
+        case OP_SPAWN: {
+            // this thread carries on after the job's code
+            VmJob* job = &jobs[in->a];
+            *job = (VmJob){
+                .p = p,
+                .start = in + 1,
+                .end = p->code + in->b,
+                .dst = in->dst,
+                .jobs = jobs
+            };
+            pool_spawn(&job->task, vm_job, job);
+            in = job->end - 1;
+            continue;
+        }
+        case OP_JOIN:
+            pool_join(&jobs[in->a].task);
+            r[in->dst] = jobs[in->a].result;
+            continue;
+        case OP_RET:
+            // whoever gets it may keep it anywhere
+            v = r[in->a];
+            v.owned = false;
+            apc_free(r);
+            apc_free(ctxs);
+            return v;
+        }
+
+        // a new value, unless an operand was passed through as is
+        if (v.number.digits_end != r[in->a].number.digits_end) {
+            v.owned = true;
+        }
+
+        if (memo) {
+            memo_insert(&key, &v);
+        }
+        if (in->ctx >= 0) {
+            v = vm_reduce(&ctxs[in->ctx], v);
+            v.owned = true;
+        }
+        r[in->dst] = v;
+    }
+}
@@ -3,12 +3,17 @@
 import os
 from io import StringIO
 import sys
+import math
 import random
 from random import randint
 import subprocess
 from dataclasses import dataclass
 import numpy
 
+# the operands past the kernel thresholds print to more than python's
+# default 4300 digits
+sys.set_int_max_str_digits(0)
+
 N = 100
 DIGITS = "0123456789abcdefghjiklmnopqrstuvwxyz"
 FAKE, MP, REAL = 0, 1, 2
@@ -55,16 +60,52 @@ def run_command(command):
     return result.stdout
 
 # returns the output of apc as a string
-def test_apc(test_input: str) -> str:
+def test_apc(test_input: str, env: dict = {}) -> str:
     result = subprocess.run(
         ['build/apc', test_input],
         shell=False,
         capture_output=True,
+        env={**os.environ, **env},
         text=True)
 
     lines = result.stdout.split('\n')
     return lines[-2].strip('\n =')
 
+# pipes lines into the repl, returns what it answered to each one and its
+# exit code
+def test_apc_repl(lines: list, env: dict = {}) -> tuple:
+    result = subprocess.run(
+        ['build/apc'],
+        input="".join(f"{line}\n" for line in lines),
+        shell=False,
+        capture_output=True,
+        env={**os.environ, **env},
+        text=True)
+
+    # every answer follows a prompt, " =  = answer"
+    answers = result.stdout.split('\n')[:len(lines)]
+    return [a.strip('\n =') for a in answers], result.returncode
+
+# each session is a list of (line, expected answer)
+def run_repl_sessions(sessions: list, env: dict = {}) -> int:
+    passed = 0
+
+    for session in sessions:
+        lines = [line for line, _ in session]
+        expected = [answer for _, answer in session]
+        answers, returncode = test_apc_repl(lines, env)
+
+        if answers == expected and returncode == 0:
+            passed += 1
+        else:
+            print(f"{lines=}\n"
+                f"{expected=}\n"
+                f"{answers=}\n"
+                f"{returncode=}\n")
+
+    print(f"passed {passed} / {len(sessions)}")
+    return passed
+
 @dataclass
 class Expr:
     py_expr: str
@@ -94,6 +135,10 @@ class Expr:
         return Expr(f"{self.py_expr} % {e.py_expr}",
                     f"{self.apc_expr} % {e.apc_expr}")
 
+    def pow(self, e):
+        return Expr(f"({self.py_expr}) ** {e.py_expr}",
+                    f"({self.apc_expr}) ^ {e.apc_expr}")
+
 def random_bigstr(base: int, n_digits: int = 100) -> str:
     all_digits = "0123456789abcdefghijklmnopqrstuvwxyz"
     valid_digits = all_digits[0:base]
@@ -120,7 +165,381 @@ def random_short_expr():
             random_bignum().mul(random_bignum()),
             random_bignum().intdiv(random_digit()),
             random_bignum().mod(random_digit()),
-        ], weights=[1,1,1,1,1], k=1)[0]
+            random_bignum().pow(Expr(str(randint(0, 20)))),
+        ], weights=[1,1,1,1,1,1], k=1)[0]
+
+def random_signed_bignum() -> Expr:
+    e = random_bignum()
+    if randint(0, 1):
+        return Expr(f"(-{e.py_expr})", f"(-{e.apc_expr})")
+    return e
+
+def random_positive_bignum() -> Expr:
+    e = random_bignum()
+    return e if eval(e.py_expr) > 0 else Expr("1")
+
+def random_small(lo: int, hi: int) -> Expr:
+    return Expr(str(randint(lo, hi)))
+
+# one call to a builtin, with arguments in its domain, and the same call in
+# python
+
+def random_powmod() -> Expr:
+    a = random_signed_bignum()
+    e = random.choice([random_small(0, 2000), random_positive_bignum()])
+    m = random_positive_bignum()
+    return Expr(f"pow({a.py_expr}, {e.py_expr}, {m.py_expr})",
+                f"powmod({a.apc_expr}, {e.apc_expr}, {m.apc_expr})")
+
+def random_mod_call() -> Expr:
+    m = random_positive_bignum()
+    x = random_signed_bignum().mul(random_bignum()).sub(random_bignum())
+    return Expr(f"({x.py_expr}) % {m.py_expr}",
+                f"mod({m.apc_expr}, {x.apc_expr})")
+
+def py_invmod(a, m):
+    try:
+        return pow(a, -1, m)
+    except ValueError:
+        return "value error"
+
+def random_gcd() -> Expr:
+    a, b = random_signed_bignum(), random_signed_bignum()
+    return Expr(f"math.gcd({a.py_expr}, {b.py_expr})",
+                f"gcd({a.apc_expr}, {b.apc_expr})")
+
+def random_lcm() -> Expr:
+    a, b = random_signed_bignum(), random_signed_bignum()
+    return Expr(f"math.lcm({a.py_expr}, {b.py_expr})",
+                f"lcm({a.apc_expr}, {b.apc_expr})")
+
+def random_invmod() -> Expr:
+    a, m = random_signed_bignum(), random_positive_bignum()
+    return Expr(f"py_invmod({a.py_expr}, {m.py_expr})",
+                f"invmod({a.apc_expr}, {m.apc_expr})")
+
+def py_iroot(n, k):
+    if n < 0:
+        return -py_iroot(-n, k)
+    if n == 0:
+        return 0
+    x = 1 << ((n.bit_length() + k - 1) // k)
+    while True:
+        y = ((k - 1) * x + n // x**(k - 1)) // k
+        if y >= x:
+            return x
+        x = y
+
+def random_isqrt() -> Expr:
+    n = random_bignum()
+    return Expr(f"math.isqrt({n.py_expr})", f"isqrt({n.apc_expr})")
+
+def random_iroot() -> Expr:
+    k = randint(1, 20)
+    n = random_signed_bignum() if k % 2 else random_bignum()
+    return Expr(f"py_iroot({n.py_expr}, {k})", f"iroot({n.apc_expr}, {k})")
+
+def random_fact() -> Expr:
+    n = randint(0, 600)
+    return Expr(f"math.factorial({n})", f"fact({n})")
+
+def random_binom() -> Expr:
+    n = randint(0, 600)
+    k = randint(0, n + 10)
+    return Expr(f"math.comb({n}, {k})", f"binom({n}, {k})")
+
+def py_fib(n):
+    a, b = 0, 1
+    for _ in range(n):
+        a, b = b, a + b
+    return a
+
+def py_lucas(n):
+    a, b = 2, 1
+    for _ in range(n):
+        a, b = b, a + b
+    return a
+
+def random_fib() -> Expr:
+    n = randint(0, 3000)
+    return Expr(f"py_fib({n})", f"fib({n})")
+
+def random_lucas() -> Expr:
+    n = randint(0, 3000)
+    return Expr(f"py_lucas({n})", f"lucas({n})")
+
+# floor(pi * 10^d), machin's formula with guard digits
+def py_pi(d):
+    unity = 10**(d + 10)
+    def arctan_inv(x):
+        total = term = unity // x
+        k = 1
+        while term:
+            term //= -x * x
+            total += term // (2 * k + 1)
+            k += 1
+        return total
+    return 4 * (4 * arctan_inv(5) - arctan_inv(239)) // 10**10
+
+# floor(e * 10^d), the sum of 1/k! with guard digits
+def py_e(d):
+    term = unity = 10**(d + 10)
+    total = 0
+    k = 0
+    while term:
+        total += term
+        k += 1
+        term //= k
+    return total // 10**10
+
+def random_pi() -> Expr:
+    d = randint(0, 300)
+    return Expr(f"py_pi({d})", f"pi({d})")
+
+def random_e() -> Expr:
+    d = randint(0, 300)
+    return Expr(f"py_e({d})", f"e({d})")
+
+BUILTIN_GENERATORS = [
+    random_powmod,
+    random_mod_call,
+    random_gcd, random_lcm, random_invmod,
+    random_isqrt, random_iroot,
+    random_fact, random_binom,
+    random_fib, random_lucas,
+    random_pi, random_e,
+]
+
+# the corners of each builtin - modulus 1, even moduli in base 10, k > n,
+# n = 0
+BUILTIN_EDGE_CASES = [
+    Expr("pow(12345, 678, 1)", "powmod(12345, 678, 1)"),
+    Expr("pow(-12345, 0, 1)", "powmod(-12345, 0, 1)"),
+    Expr("pow(0, 0, 7)", "powmod(0, 0, 7)"),
+    Expr("pow(3, 12345, 2**64)", "powmod(3, 12345, 2^64)"),
+    Expr("pow(7, 10**6, 10**30)", "powmod(7, 10^6, 10^30)"),
+    Expr("pow(-7, 10**6 + 1, 2 * 3**50)", "powmod(-7, 10^6 + 1, 2 * 3^50)"),
+    Expr("123456789 ** 5 % 1", "mod(1, 123456789 ^ 5)"),
+    Expr("(3**500 - 1) % 2**100", "mod(2^100, 3^500 - 1)"),
+    Expr("(5**300 * 7**200) % (10**40)", "mod(10^40, 5^300 * 7^200)"),
+    Expr("py_invmod(12345, 1)", "invmod(12345, 1)"),
+    Expr("py_invmod(4, 8)", "invmod(4, 8)"),
+    Expr("math.gcd(0, 0)", "gcd(0, 0)"),
+    Expr("math.gcd(0, -5)", "gcd(0, -5)"),
+    Expr("math.lcm(0, 7)", "lcm(0, 7)"),
+    Expr("math.isqrt(0)", "isqrt(0)"),
+    Expr("py_iroot(0, 3)", "iroot(0, 3)"),
+    Expr("math.comb(5, 7)", "binom(5, 7)"),
+    Expr("math.comb(0, 3)", "binom(0, 3)"),
+    Expr("math.comb(0, 0)", "binom(0, 0)"),
+    Expr("math.comb(600, 0)", "binom(600, 0)"),
+    Expr("math.factorial(0)", "fact(0)"),
+    Expr("py_fib(0)", "fib(0)"),
+    Expr("py_lucas(0)", "lucas(0)"),
+    Expr("py_pi(0)", "pi(0)"),
+    Expr("py_e(0)", "e(0)"),
+]
+
+def run_test_apc_builtins():
+    passed = 0
+    total = 0
+
+    cases = BUILTIN_EDGE_CASES + [
+        g() for g in BUILTIN_GENERATORS for i in range(N)]
+
+    for e in cases:
+        py_answer = str(eval(e.py_expr))
+        apc_answer = test_apc(f"({e.apc_expr}) # 10")
+
+        total += 1
+        if py_answer == apc_answer:
+            passed += 1
+        else:
+            print(f"{e.apc_expr=}\n"
+                f"{py_answer=}\n"
+                f"{apc_answer=}\n")
+
+    print(f"passed {passed} / {total}")
+
+# a number of n digits the way apc stores it in base b, either sign - n at a
+# kernel's threshold is the shortest operand that takes that kernel
+def random_limbs(b: int, n: int) -> int:
+    x = randint(BASES[b][REAL] ** (n - 1), BASES[b][REAL] ** n - 1)
+    return -x if randint(0, 1) else x
+
+# x in base 10 or 16, both of which python writes in linear time
+def apc_literal(x: int, b: int) -> str:
+    if b == 16:
+        return f"({'-' if x < 0 else ''}{abs(x):x}_16)"
+    return f"({x})"
+
+# each (apc_expr, answer) printed in base 10 against python's
+def run_large_cases(cases: list, env: dict = {}):
+    passed = 0
+
+    for apc_expr, n in cases:
+        py_answer = str(n)
+        apc_answer = test_apc(f"({apc_expr}) # 10", env)
+
+        if py_answer == apc_answer:
+            passed += 1
+        else:
+            print(f"{apc_expr[:100]=}\n"
+                f"{py_answer[:100]=}\n"
+                f"{apc_answer[:100]=}\n")
+
+    print(f"passed {passed} / {len(cases)}")
+
+# products and squares just past the karatsuba thresholds, balanced and
+# not, with a square as x * x and as x ^ 2
+def run_test_apc_karatsuba():
+    cases = []
+
+    for i in range(N):
+        b, c = random.choice([10, 16]), random.choice([10, 16])
+        x = random_limbs(b, 32 + randint(0, 24))
+        y = random_limbs(c, 32 + randint(0, 24) * randint(1, 4))
+        cases.append((f"{apc_literal(x, b)} * {apc_literal(y, c)}", x * y))
+
+        x = random_limbs(b, 48 + randint(0, 32))
+        if randint(0, 1):
+            cases.append((f"{apc_literal(x, b)} * {apc_literal(x, b)}", x * x))
+        else:
+            cases.append((f"{apc_literal(x, b)} ^ 2", x * x))
+
+    run_large_cases(cases)
+
+# gcd, lcm and invmod just past the half-gcd threshold, with a large common
+# factor so the gcd isn't just 1
+def run_test_apc_hgcd():
+    cases = []
+
+    for i in range(N // 2):
+        b, c = random.choice([10, 16]), random.choice([10, 16])
+        g = abs(random_limbs(b, randint(1, 60)))
+        x = g * random_limbs(b, 120 + randint(0, 60))
+        y = g * random_limbs(c, 120 + randint(0, 60))
+        cases.append((f"gcd({apc_literal(x, b)}, {apc_literal(y, c)})",
+            math.gcd(x, y)))
+        cases.append((f"lcm({apc_literal(x, b)}, {apc_literal(y, c)})",
+            math.lcm(x, y)))
+
+        x = random_limbs(b, 120 + randint(0, 60))
+        m = abs(random_limbs(c, 120 + randint(0, 60)))
+        cases.append((f"invmod({apc_literal(x, b)}, {apc_literal(m, c)})",
+            py_invmod(x, m)))
+
+    run_large_cases(cases)
+
+# division just past the newton threshold, with the quotient longer and
+# shorter than the divisor and a divisor of either sign, plus isqrt and
+# iroot of numbers long enough to divide that way
+def run_test_apc_newton_division():
+    cases = []
+
+    for i in range(N // 2):
+        b, c = random.choice([10, 16]), random.choice([10, 16])
+        # n digits of divisor, k of quotient - k < n - 2 divides the top
+        # digits first, longer ones go through barrett steps
+        n = 120 + randint(4, 140)
+        if randint(0, 1):
+            k = randint(120, n - 3)
+        else:
+            k = randint(max(120, n - 2), n + 200)
+        x = random_limbs(b, n + k)
+        y = random_limbs(c, n)
+        op = random.choice("/%")
+        cases.append((f"{apc_literal(x, b)} {op} {apc_literal(y, c)}",
+            apc_divmod(x, y)[0 if op == "/" else 1]))
+
+        x = abs(random_limbs(b, 240 + randint(0, 200)))
+        cases.append((f"isqrt({apc_literal(x, b)})", math.isqrt(x)))
+        k = randint(2, 5)
+        cases.append((f"iroot({apc_literal(x, b)}, {k})", py_iroot(x, k)))
+
+    run_large_cases(cases)
+
+# products and squares whose shorter operand is just past the parallel
+# threshold, on a pool of 4 threads whatever the machine has
+def run_test_apc_parallel_mul():
+    cases = []
+
+    for i in range(10):
+        b, c = random.choice([10, 16]), random.choice([10, 16])
+        x = random_limbs(b, 2048 + randint(0, 512))
+        y = random_limbs(c, 2048 + randint(0, 512) * randint(1, 4))
+        cases.append((f"{apc_literal(x, b)} * {apc_literal(y, c)}", x * y))
+        cases.append((f"{apc_literal(x, b)} * {apc_literal(x, b)}", x * x))
+
+    run_large_cases(cases, {"APC_THREADS": "4"})
+
+# operations long enough to be remembered across lines, each asked again
+# after a different sign, base or operation on the same operands and after
+# a result was written over in place, checked against python
+def run_test_repl_memo():
+    sessions = []
+
+    for i in range(N // 10):
+        a = random_limbs(10, 130 + randint(0, 70))
+        b = random_limbs(10, 130 + randint(0, 70))
+        session = [(f"a = {a}", str(a)), (f"b = {b}", str(b))]
+
+        for j in range(2):
+            session += [
+                ("c = a * b", str(a * b)),
+                ("a * b", str(a * b)),
+                ("c = c * 3", str(a * b * 3)),
+                ("a * b", str(a * b)),
+                ("(-a) * b", str(-a * b)),
+                ("a * (-b)", str(a * -b)),
+                ("b * a", str(a * b)),
+                ("a * a", str(a * a)),
+                ("a * b * a", str(a * b * a)),
+                ("a / b", str(apc_divmod(a, b)[0])),
+                ("a % b", str(apc_divmod(a, b)[1])),
+                ("(-a) % b", str(apc_divmod(-a, b)[1])),
+                ("a # 16", apc_repr(a, 16)),
+                ("(a # 16) * b", apc_repr(a * b, 16)),
+            ]
+            a = -a
+            session.append(("a = -a", str(a)))
+
+        sessions.append(session)
+
+    run_repl_sessions(sessions)
+
+# lines that read variables with two or more expensive subtrees side by
+# side, which run as separate jobs, on a pool of 4 threads whatever the
+# machine has - an error inside a job fails just that line
+def run_test_repl_parallel_eval():
+    sessions = []
+
+    for i in range(5):
+        x = random_limbs(10, 2100 + randint(0, 400))
+        y = random_limbs(10, 2100 + randint(0, 400))
+        session = [(f"x = {x}", str(x)), (f"y = {y}", str(y))]
+
+        exprs = [
+            ("x * x + y * y", x * x + y * y),
+            ("(x + 1) * (y - 1) - (x - 1) * y", (x + 1) * (y - 1) - (x - 1) * y),
+            ("-(x * y) + x * x - y * y", -(x * y) + x * x - y * y),
+            ("(x * y) * (x * x)", x * y * x * x),
+            ("x * x + y / (x - x)", "value error"),
+            ("(x * y) % (y * y + 1)", apc_divmod(x * y, y * y + 1)[1]),
+            ("gcd(x * y, y * y) - x * x", math.gcd(x * y, y * y) - x * x),
+        ]
+        random.shuffle(exprs)
+        session += [(e, str(n)) for e, n in exprs]
+
+        # a definition whose refresh splits too
+        session += [
+            ("z = x * x - y * y", str(x * x - y * y)),
+            ("x = 5", "5"),
+            ("z", str(25 - y * y)),
+        ]
+        sessions.append(session)
+
+    run_repl_sessions(sessions, {"APC_THREADS": "4"})
 
 def run_test_apc():
     passed = 0
@@ -184,7 +603,441 @@ def run_test_apc_base_conv():
 
     print(f"total: passed {total_passed} / {total}")
 
+# a division by zero is a value error, and the session goes on with every
+# variable as it was before the line
+def run_test_repl_division_by_zero():
+    run_repl_sessions([
+        [("x = 5/0", "value error"), ("x = 4", "4"), ("x", "4")],
+        [("x = 5%0", "value error"), ("x = 4", "4")],
+        [("x = 7", "7"), ("x = x/0", "value error"), ("x", "7")],
+        [("y = 1", "1"), ("z = y + 5/0", "value error"),
+         ("z = y + 1", "2"), ("z", "2")],
+        [("y = 0", "0"), ("z = 10/y", "value error"),
+         ("z = 10%y", "value error"), ("y", "0")],
+    ])
+
+# an input redefined so that a dependent line fails leaves that variable
+# stale, the session goes on and it recovers once the input is fixed
+def run_test_repl_refresh_error():
+    run_repl_sessions([
+        [("y = 2", "2"), ("z = 10 / y", "5"), ("y = 0", "0"),
+         ("z", "value error"), ("y = 5", "5"), ("z", "2")],
+        [("y = 2", "2"), ("z = 10 / y", "5"), ("w = z * y", "10"),
+         ("y = 0", "0"), ("w", "value error"), ("z", "value error"),
+         ("y = 1", "1"), ("w", "10"), ("z", "10")],
+    ])
+
+# a syntax error anywhere on a line wins over an undefined name or a bad
+# call, trailing tokens and a dangling base separator are syntax errors
+def run_test_repl_syntax_first():
+    run_repl_sessions([
+        [("x y", "syntax error"), ("a = b = 5", "syntax error"),
+         ("foo(1) 2", "syntax error"), ("x +", "syntax error"),
+         ("pi(1, 2) 3", "syntax error"), ("1_2_", "syntax error"),
+         ("1_2_ + 3", "syntax error"), ("5 5", "syntax error"),
+         ("x", "name error"), ("foo(1)", "name error"),
+         ("3 + pi(1, 2) + z", "value error"), ("pi(1, 2)", "value error"),
+         ("x = 5", "5"), ("x y", "syntax error"), ("x + y", "name error"),
+         ("x", "5")],
+    ])
+
+# lines that write their result back over the variable they read, checked
+# against python, including one that fails after it would have written
+def run_test_repl_write_back():
+    x = 10**300
+    session = [("x = 10^300", str(x))]
+    for k in [3, 999999999, 7, 2**40 + 1]:
+        x = x * k
+        session.append((f"x = x * {k}", str(x)))
+        x = x + k
+        session.append((f"x = x + {k}", str(x)))
+        x = x - 10**310
+        session.append(("x = x - 10^310", str(x)))
+    session += [
+        ("x = (x * 3) / 0", "value error"),
+        ("x", str(x)),
+        ("y = x + 1", str(x + 1)),
+        ("x = -x", str(-x)),
+        ("y", str(1 - x)),
+    ]
+    run_repl_sessions([session])
+
+# variables across lines - assigning, reassigning, reading them after a line
+# that failed, and reading one that was never assigned
+def run_test_repl_variables():
+    run_repl_sessions([
+        [("a = 12", "12"), ("a", "12"), ("a = 5", "5"), ("a + 1", "6")],
+        [("a = 12", "12"), ("b = 7", "7"), ("a = b", "7"), ("b = 1", "1"),
+         ("a", "1"), ("ab = 3", "3"), ("a * ab", "3")],
+        [("a = 12", "12"), ("a = a +", "syntax error"), ("a", "12"),
+         ("a = a / 0", "value error"), ("a", "12"), ("a = a + 1", "13")],
+        [("nope", "name error"), ("a = nope + 1", "name error"),
+         ("a", "name error"), ("a = 2", "2"), ("a + nope", "name error"),
+         ("a", "2")],
+        [("a = 10 # 16", "A_16"), ("a", "A_16"), ("a = a * 2", "14_16"),
+         ("a # 10", "20")],
+    ])
+
+# how apc prints n in base b
+def apc_repr(n: int, b: int) -> str:
+    if n == 0:
+        return "0"
+    sign = "-" if n < 0 else ""
+    suffix = f"_{b}" if b != 10 else ""
+    return f"{sign}{numpy.base_repr(abs(n), base=b)}{suffix}"
+
+# apc's division, a0 < a1 gives [0, a0] for any signs, otherwise the
+# magnitudes are divided
+def apc_divmod(a0: int, a1: int) -> tuple:
+    if abs(a1) == 1:
+        return a0, 0
+    if a0 < a1:
+        return 0, a0
+    if a0 == a1:
+        return 1, 0
+    return abs(a0) // abs(a1), abs(a0) % abs(a1)
+
+# a value that fits in a single digit of base b, the largest one included
+def random_word(b: int) -> int:
+    return random.choice([
+        0, 1, 2, BASES[b][REAL] - 1, randint(0, BASES[b][REAL] - 1)
+    ])
+
+# a bignum with one operand that's a single digit, of its own base or of
+# another one whose digit doesn't fit in a digit of the first, either sign,
+# either side, checked against python
+def run_test_apc_word_operands():
+    passed = 0
+    total = 0
+
+    for b in range(2, 37):
+        for i in range(30):
+            c = b if randint(0, 1) else randint(2, 36)
+            w = random_word(c)
+            op = random.choice("+-*/%")
+
+            # sometimes right around w, so both compare either way
+            x = int(random_bigstr(b, n_digits = randint(1, 60)), b)
+            if randint(0, 3) == 0:
+                x = max(0, w + randint(-1, 1))
+            x = -x if randint(0, 1) else x
+
+            if op not in "/%" or randint(0, 3) == 0:
+                w = -w if randint(0, 1) else w
+
+            x_str = f"({'-' if x < 0 else ''}{numpy.base_repr(abs(x), base=b)}_{b})"
+            w_str = f"({'-' if w < 0 else ''}{numpy.base_repr(abs(w), base=c)}_{c})"
+
+            # the divisor is the word
+            swap = op not in "/%" and randint(0, 1)
+            apc_expr = f"{w_str} {op} {x_str}" if swap else f"{x_str} {op} {w_str}"
+            a0, a1 = (w, x) if swap else (x, w)
+
+            if op == "+":
+                n = a0 + a1
+            elif op == "-":
+                n = a0 - a1
+            elif op == "*":
+                n = a0 * a1
+            elif a1 == 0:
+                n = None
+            elif op == "/":
+                n = apc_divmod(a0, a1)[0]
+            else:
+                n = apc_divmod(a0, a1)[1]
+
+            py_answer = "value error" if n is None else apc_repr(n, c if swap else b)
+            apc_answer = test_apc(apc_expr)
+
+            total += 1
+            if py_answer == apc_answer:
+                passed += 1
+            else:
+                print(f"{apc_expr=  }\n"
+                    f"{py_answer= }\n"
+                    f"{apc_answer=}\n")
+
+    print(f"passed {passed} / {total}")
+
+# a negative divisor of several digits, under a dividend of either sign
+# that's longer or shorter than it, checked against python
+def run_test_apc_negative_divisors():
+    passed = 0
+    total = 0
+
+    for b in range(2, 37):
+        w = BASES[b][MP]
+        for i in range(20):
+            y = int(random_bigstr(b, n_digits = randint(w + 1, 5 * w)), b)
+            if randint(0, 1):
+                x = int(random_bigstr(b, n_digits = randint(1, w)), b)
+            else:
+                x = int(random_bigstr(b, n_digits = randint(6 * w, 12 * w)), b)
+            x = -x if randint(0, 1) else x
+            y = -y
+            op = random.choice("/%")
+
+            x_str = f"({'-' if x < 0 else ''}{numpy.base_repr(abs(x), base=b)}_{b})"
+            y_str = f"(-{numpy.base_repr(-y, base=b)}_{b})"
+            apc_expr = f"{x_str} {op} {y_str}"
+
+            n = apc_divmod(x, y)[0 if op == "/" else 1]
+            py_answer = apc_repr(n, b)
+            apc_answer = test_apc(apc_expr)
+
+            total += 1
+            if py_answer == apc_answer:
+                passed += 1
+            else:
+                print(f"{apc_expr=  }\n"
+                    f"{py_answer= }\n"
+                    f"{apc_answer=}\n")
+
+    print(f"passed {passed} / {total}")
+
+    # the session and its variables outlive the division
+    run_repl_sessions([
+        [("x = 5", "5"),
+         ("2 / -123456789012345678901234567890", "0"),
+         ("x % -1234567890123", "5"),
+         ("x", "5")],
+    ])
+
+# numbers with whole zero digits (of real_base) in them, which still print
+# as width characters, 10^9 included, read in and printed back
+def run_test_apc_zero_digits():
+    passed = 0
+    total = 0
+
+    for b in range(2, 37):
+        real, width = BASES[b][REAL], BASES[b][MP]
+        numbers = [real, real**2, real**3 + 1, real**2 * (real - 1)]
+        for i in range(10):
+            limbs = [random.choice([0, 0, 1, randint(0, real - 1)])
+                     for _ in range(randint(1, 8))]
+            numbers.append(sum(l * real**k for k, l in enumerate(limbs)))
+
+        for n in numbers:
+            py_answer = apc_repr(n, b)
+            apc_answer = test_apc(f"{numpy.base_repr(n, base=b)}_{b}")
+
+            total += 1
+            if py_answer == apc_answer:
+                passed += 1
+            else:
+                print(f"{py_answer= }\n"
+                    f"{apc_answer=}\n")
+
+    # 10^9 is a single 1 followed by a zero digit
+    for e in range(0, 40):
+        total += 1
+        if test_apc(f"10^{e}") == str(10**e):
+            passed += 1
+        else:
+            print(f"10^{e} = {test_apc(f'10^{e}')}")
+
+    print(f"passed {passed} / {total}")
+
+# dividing by a power of the base that shifts out every digit, or reducing
+# something shorter than the modulus, still gives a zero in that base
+# adding 10_b after it shows which base the zero was in
+def run_test_apc_shift_out():
+    passed = 0
+    total = 0
+
+    for b in range(2, 37):
+        if b == 10:
+            continue
+        for i in range(10):
+            n = randint(1, 40)
+            x = int(random_bigstr(b, n_digits = n), b)
+            k = n + randint(0, 20)
+            p = "1" + "0" * k
+
+            m = int(random_bigstr(b, n_digits = n + randint(1, 20)), b)
+            m_str = f"{numpy.base_repr(m, base=b)}_{b}"
+            x_str = f"{numpy.base_repr(x, base=b)}_{b}"
+
+            cases = [
+                (f"({x_str} / {p}_{b}) + 10_{b}", b),
+                (f"mod({m_str}, {x_str} * 1_{b}) + 10_{b}", x % m + b),
+            ]
+            for apc_expr, n_answer in cases:
+                py_answer = apc_repr(n_answer, b)
+                apc_answer = test_apc(apc_expr)
+
+                total += 1
+                if py_answer == apc_answer:
+                    passed += 1
+                else:
+                    print(f"{apc_expr=  }\n"
+                        f"{py_answer= }\n"
+                        f"{apc_answer=}\n")
+
+    print(f"passed {passed} / {total}")
+
+# a digit of real_base > 2^31 plus another overflows 32 bits - long runs of
+# the largest digit carry all the way through, checked against python
+# then differences and products that come out 0, plus 10_b to show the base
+def run_test_apc_add_carry():
+    passed = 0
+    total = 0
+
+    for b in range(2, 37):
+        for i in range(10):
+            cases = []
+
+            if BASES[b][REAL] > 2**31:
+                top = DIGITS[b - 1]
+                x_str = top * randint(1, 80)
+                y_str = random.choice([top, "1", random_bigstr(b, randint(1, 80))])
+                x, y = int(x_str, b), int(y_str, b)
+                cases += [
+                    (f"{x_str}_{b} + {y_str}_{b}", x + y),
+                    (f"{y_str}_{b} + {x_str}_{b}", x + y),
+                    (f"{x_str}_{b} + {x_str}_{b} + {y_str}_{b}", 2 * x + y),
+                ]
+
+            if b != 10:
+                x_str = random_bigstr(b, n_digits = randint(2, 80))
+                c = random.choice([c for c in range(2, 37) if c != b])
+                y_str = random_bigstr(c, n_digits = randint(2, 80))
+                cases += [
+                    (f"({x_str}_{b} - {x_str}_{b}) + 10_{b}", b),
+                    (f"({x_str}_{b} * 0_{b}) + 10_{b}", b),
+                    (f"(0_{b} * {y_str}_{c}) + 10_{b}", b),
+                ]
+
+            for apc_expr, n in cases:
+                py_answer = apc_repr(n, b)
+                apc_answer = test_apc(apc_expr)
+
+                total += 1
+                if py_answer == apc_answer:
+                    passed += 1
+                else:
+                    print(f"{apc_expr=  }\n"
+                        f"{py_answer= }\n"
+                        f"{apc_answer=}\n")
+
+    print(f"passed {passed} / {total}")
+
+# operands in different bases are converted to the first one's, and keep
+# their sign on the way, e.g. (-30_7) * (-5_16) is positive
+def run_test_apc_mixed_base_signs():
+    passed = 0
+    total = 0
+
+    for b in range(2, 37):
+        for i in range(10):
+            c = random.choice([c for c in range(2, 37) if c != b])
+            x = int(random_bigstr(b, n_digits = randint(1, 60)), b)
+            y = int(random_bigstr(c, n_digits = randint(1, 60)), c)
+            x = -x if randint(0, 1) else x
+            y = -y if randint(0, 1) else y
+
+            x_str = f"({'-' if x < 0 else ''}{numpy.base_repr(abs(x), base=b)}_{b})"
+            y_str = f"({'-' if y < 0 else ''}{numpy.base_repr(abs(y), base=c)}_{c})"
+
+            for op, n in [("+", x + y), ("-", x - y), ("*", x * y)]:
+                py_answer = apc_repr(n, b)
+                apc_answer = test_apc(f"{x_str} {op} {y_str}")
+
+                total += 1
+                if py_answer == apc_answer:
+                    passed += 1
+                else:
+                    print(f"apc_expr='{x_str} {op} {y_str}'\n"
+                        f"{py_answer= }\n"
+                        f"{apc_answer=}\n")
+
+    print(f"passed {passed} / {total}")
+
+VARS = "abcd"
+
+def random_def_expr(depth: int = 2) -> str:
+    r = randint(0, 5)
+    if depth == 0 or r < 2:
+        if randint(0, 1):
+            return random.choice(VARS)
+        return str(randint(0, 10**randint(1, 20)))
+    if r == 2:
+        return f"(-{random_def_expr(depth - 1)})"
+    op = random.choice("+-*")
+    return f"({random_def_expr(depth - 1)} {op} {random_def_expr(depth - 1)})"
+
+# random sessions checked against a model of the symbol table - a line that
+# reads other variables keeps following them, one that reads itself or would
+# close a cycle through other definitions is kept as a plain value
+def run_test_repl_definitions():
+    sessions = []
+
+    for _ in range(N):
+        defs = {}       # name => (expression, names it reads)
+        values = {}     # name => value it was last assigned
+
+        def value(name):
+            if name in defs:
+                expr, deps = defs[name]
+                return eval(expr, {}, {d: value(d) for d in deps})
+            return values[name]
+
+        # whether name is one of deps, or what they're defined from
+        def reaches(name, deps):
+            return any(d == name or (d in defs and reaches(name, defs[d][1]))
+                       for d in deps)
+
+        session = []
+        for _ in range(randint(10, 40)):
+            name = random.choice(VARS)
+            r = randint(0, 5)
+            if r < 2:
+                # just read it
+                session.append((name, str(value(name))
+                    if name in values else "name error"))
+                continue
+            if r == 2:
+                expr = f"{name} + 1"
+            else:
+                expr = random_def_expr()
+
+            deps = {v for v in VARS if v in expr}
+            if any(d not in values for d in deps):
+                session.append((f"{name} = {expr}", "name error"))
+                continue
+
+            x = eval(expr, {}, {d: value(d) for d in deps})
+            defs.pop(name, None)
+            if deps and not reaches(name, deps):
+                defs[name] = (expr, deps)
+            values[name] = x
+            session.append((f"{name} = {expr}", str(x)))
+
+        sessions.append(session)
+
+    run_repl_sessions(sessions)
+
 def main():
+    run_test_repl_variables()
+    run_test_repl_division_by_zero()
+    run_test_repl_refresh_error()
+    run_test_repl_syntax_first()
+    run_test_repl_definitions()
+    run_test_apc()
+    run_test_apc_word_operands()
+    run_test_apc_negative_divisors()
+    run_test_apc_zero_digits()
+    run_test_apc_shift_out()
+    run_test_apc_add_carry()
+    run_test_apc_mixed_base_signs()
+    run_test_apc_builtins()
+    run_test_apc_karatsuba()
+    run_test_apc_hgcd()
+    run_test_apc_newton_division()
+    run_test_apc_parallel_mul()
+    run_test_repl_write_back()
+    run_test_repl_memo()
+    run_test_repl_parallel_eval()
     run_test_apc_base_conv()
 
 if __name__ == '__main__':